@@ -5,6 +5,7 @@
 module;
 
 #include <algorithm>
+#include <cstdint>
 #include <random>
 #include <string>
 #include <fstream>
@@ -72,16 +73,23 @@ private:
 };
 
 #pragma region RNG
-class RandomGenerator
+//any engine usable with the <random> distributions, the game plays on std::mt19937
+template <std::uniform_random_bit_generator Engine>
+class BasicRandomGenerator
 {
 public:
-    static std::mt19937& getGenerator()
+    static Engine& getGenerator()
     {
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
+        static Engine gen(randomSeed());
         return gen;
     }
 
+    //replays the same game from a fixed seed
+    static void seed(uint64_t seed)
+    {
+        getGenerator() = Engine(seed);
+    }
+
     static float getRandomValue()
     {
         static std::uniform_real_distribution<float> dist_f(0, 1);
@@ -111,7 +119,16 @@ public:
         static std::uniform_int_distribution dist_i(1, 6);
         return dist_i(getGenerator());
     }
+
+private:
+    static uint64_t randomSeed()
+    {
+        std::random_device rd;
+        return (static_cast<uint64_t>(rd()) << 32) | rd();
+    }
 };
+
+using RandomGenerator = BasicRandomGenerator<std::mt19937>;
 #pragma endregion RNG
 
 
@@ -287,14 +287,14 @@ public: //Additional functions
         return ConstIterator(*this, m_size, false);
     }
 
-    //for lab3
-    T* beginPtr() const
+    //contiguous storage, lets val::sort (lab3) sort the array in place
+    T* data()
     {
         return m_data;
     }
-    T* endPtr() const
+    const T* data() const
     {
-        return m_data+m_size;
+        return m_data;
     }
 };
 
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+#include "permutation.hpp"
+#include "sort.hpp"
+
+namespace val
+{
+    //indirect sort: returns perm such that first[perm[0]], first[perm[1]], ... is sorted by comp.
+    //only the indices are moved, so large records cost sizeof(Index) per swap and the elements themselves
+    //don't have to be movable. Index can be narrowed (e.g. argsort<uint32_t>) when the range fits
+    template <typename Index = size_t, std::random_access_iterator It, typename Compare = std::ranges::less>
+    std::vector<Index> argsort(It first, It last, Compare comp = {})
+    {
+        size_t len = last - first;
+        if (len > 0 && static_cast<size_t>(static_cast<Index>(len - 1)) != len - 1)
+            throw std::length_error("argsort index type is too narrow for the range");
+
+        std::vector<Index> perm(len);
+        std::iota(perm.begin(), perm.end(), Index(0));
+        val::sort(perm.data(), perm.data() + len, [&](Index a, Index b)
+        {
+            return std::invoke(comp, first[a], first[b]);
+        });
+        return perm;
+    }
+}
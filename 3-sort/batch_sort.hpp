@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <numeric>
+#include <ranges>
+#include <utility>
+#include <vector>
+#include "network_sort.hpp"
+#include "parallel_sort.hpp"
+#include "sort.hpp"
+
+namespace val
+{
+    //elements one thread takes from sort_many at a time
+    inline constexpr size_t BATCH_SORT_CHUNK = 1 << 14;
+
+    namespace batch
+    {
+        template <size_t N, typename T, typename Compare>
+        void NetworkKernel(T* data, Compare& comp)
+        {
+            val::sort<N>(data, comp);
+        }
+
+        //runtime size -> compile time network, index is the array size
+        template <typename T, typename Compare, size_t... N>
+        constexpr auto MakeNetworkTable(std::index_sequence<N...>)
+        {
+            return std::array<void (*)(T*, Compare&), sizeof...(N)>{&NetworkKernel<N, T, Compare>...};
+        }
+
+        template <typename T, typename Compare>
+        inline constexpr auto NETWORK_TABLE = MakeNetworkTable<T, Compare>(std::make_index_sequence<NETWORK_SORT_MAX + 1>());
+
+        //every size up to SIMD_SORT_MAX is its own class, so a run of arrays calls the same kernel,
+        //above that powers of 2
+        inline constexpr size_t SIZE_CLASSES = SIMD_SORT_MAX + 65;
+
+        inline size_t SizeClass(size_t size)
+        {
+            return size <= SIMD_SORT_MAX ? size : SIMD_SORT_MAX + std::bit_width(size);
+        }
+
+        //the AVX2 networks beat the scalar ones from this size up, below it the scalar ones win
+        inline constexpr size_t SIMD_MIN = 8;
+
+        template <typename T, typename Compare>
+        void SortOne(T* data, size_t size, Compare& comp)
+        {
+            if constexpr (SimdSortEligible<T, Compare>)
+            {
+                if (size >= SIMD_MIN && size <= SIMD_SORT_MAX && SimdSortAvailable())
+                {
+                    SimdSort(data, data + size);
+                    return;
+                }
+            }
+            if (size <= NETWORK_SORT_MAX) NETWORK_TABLE<T, Compare>[size](data, comp);
+            else val::sort(data, data + size, comp);
+        }
+    } //namespace batch
+
+    //sorts every array in arrays (spans, vectors, anything contiguous) independently.
+    //chunks of consecutive arrays with at most about BATCH_SORT_CHUNK elements (a larger array is a chunk of its
+    //own) are handed out to the threads through an atomic counter, biggest first, within a chunk the arrays are grouped by size class so the same kernel runs back to back:
+    //sorting networks up to NETWORK_SORT_MAX (SIMD ones where available), val::sort above
+    template <std::ranges::random_access_range R, typename Compare = std::ranges::less>
+        requires std::ranges::contiguous_range<std::ranges::range_reference_t<R>>
+    void sort_many(R&& arrays, Compare comp = {}, unsigned threads = 0)
+    {
+        using T = std::ranges::range_value_t<std::ranges::range_reference_t<R>>;
+        size_t count = std::ranges::size(arrays);
+        auto begin = std::ranges::begin(arrays);
+
+        //chunks of consecutive arrays, so every thread stays within one region of memory.
+        //a chunk ends before an array that would overflow it, so a large array doesn't drag tiny ones along
+        std::vector<size_t> chunks = {0};
+        std::vector<size_t> chunkElements;
+        size_t total = 0;
+        size_t elements = 0;
+        for (size_t a = 0; a < count; a++)
+        {
+            size_t size = std::ranges::size(begin[a]);
+            if (elements > 0 && elements + size > BATCH_SORT_CHUNK)
+            {
+                chunks.push_back(a);
+                chunkElements.push_back(elements);
+                elements = 0;
+            }
+            total += size;
+            elements += size;
+        }
+        if (chunks.back() != count)
+        {
+            chunks.push_back(count);
+            chunkElements.push_back(elements);
+        }
+
+        //longest processing time first: the big chunks start early and the small ones fill the gaps at the end
+        std::vector<size_t> schedule(chunkElements.size());
+        std::iota(schedule.begin(), schedule.end(), 0);
+        std::stable_sort(schedule.begin(), schedule.end(),
+                         [&](size_t x, size_t y) { return chunkElements[x] > chunkElements[y]; });
+
+        if (threads == 0) threads = DefaultThreadCount();
+        threads = static_cast<unsigned>(std::clamp<size_t>(total / PARALLEL_MIN_CHUNK, 1, threads));
+        std::atomic<size_t> next{0};
+        ParallelFor(threads, [&](unsigned)
+        {
+            Compare local = comp;
+            std::array<size_t, batch::SIZE_CLASSES + 1> classBegin;
+            std::vector<size_t> order;
+            for (size_t i = next++; i < schedule.size(); i = next++)
+            {
+                //stable counting sort of the chunk's arrays by size class
+                size_t c = schedule[i];
+                size_t from = chunks[c];
+                size_t to = chunks[c + 1];
+                classBegin.fill(0);
+                for (size_t a = from; a < to; a++) classBegin[batch::SizeClass(std::ranges::size(begin[a])) + 1]++;
+                for (size_t k = 1; k <= batch::SIZE_CLASSES; k++) classBegin[k] += classBegin[k - 1];
+                order.resize(to - from);
+                for (size_t a = from; a < to; a++)
+                    order[classBegin[batch::SizeClass(std::ranges::size(begin[a]))]++] = a;
+
+                for (size_t a : order)
+                {
+                    auto&& array = begin[a];
+                    batch::SortOne<T, Compare>(std::ranges::data(array), std::ranges::size(array), local);
+                }
+            }
+        });
+    }
+}
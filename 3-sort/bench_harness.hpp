@@ -0,0 +1,197 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace val::bench
+{
+    enum class Counter
+    {
+        Cycles,
+        Instructions,
+        BranchMisses,
+        L1DMisses,
+        LLCMisses,
+        Count,
+    };
+
+    inline constexpr size_t COUNTER_COUNT = static_cast<size_t>(Counter::Count);
+    inline constexpr std::string_view COUNTER_NAMES[COUNTER_COUNT] = {
+        "cycles", "instructions", "branch-misses", "L1d-misses", "LLC-misses"};
+
+    //one value per counter, empty where the counter couldn't be opened
+    using CounterValues = std::array<std::optional<double>, COUNTER_COUNT>;
+
+    //hardware counters of the calling thread and of the threads it starts after construction (user space only)
+    //around a measured region, from perf_event_open. counters the kernel refuses (no PMU in a VM, perf_event_paranoid, not linux) are simply missing
+    class PerfCounters
+    {
+    public:
+        PerfCounters()
+        {
+            m_fds.fill(-1);
+#if defined(__linux__)
+            constexpr uint64_t READ_MISS = PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+            const std::pair<uint32_t, uint64_t> events[COUNTER_COUNT] = {
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+                {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+                {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | READ_MISS},
+                {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | READ_MISS},
+            };
+            for (size_t c = 0; c < COUNTER_COUNT; c++)
+            {
+                perf_event_attr attr{};
+                attr.size = sizeof(attr);
+                attr.type = events[c].first;
+                attr.config = events[c].second;
+                attr.disabled = 1;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                //the parallel engines start their workers inside the region, their counts are added on exit
+                attr.inherit = 1;
+                //counters are opened separately, the kernel may multiplex them and the value is scaled back
+                attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+                m_fds[c] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            }
+#endif
+        }
+
+        ~PerfCounters()
+        {
+#if defined(__linux__)
+            for (int fd : m_fds)
+                if (fd >= 0) close(fd);
+#endif
+        }
+
+        PerfCounters(const PerfCounters&) = delete;
+        PerfCounters& operator=(const PerfCounters&) = delete;
+
+        bool available() const
+        {
+            return std::any_of(m_fds.begin(), m_fds.end(), [](int fd) { return fd >= 0; });
+        }
+
+        //a reset doesn't clear what exited threads added, so the region is the difference of two reads
+        void start()
+        {
+#if defined(__linux__)
+            for (size_t c = 0; c < COUNTER_COUNT; c++)
+            {
+                if (m_fds[c] < 0) continue;
+                if (read(m_fds[c], m_start[c].data(), sizeof(m_start[c])) != sizeof(m_start[c])) m_start[c].fill(0);
+                ioctl(m_fds[c], PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        }
+
+        CounterValues stop()
+        {
+            CounterValues values;
+#if defined(__linux__)
+            for (int fd : m_fds)
+                if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            for (size_t c = 0; c < COUNTER_COUNT; c++)
+            {
+                std::array<uint64_t, 3> data;
+                if (m_fds[c] < 0 || read(m_fds[c], data.data(), sizeof(data)) != sizeof(data)) continue;
+                for (size_t i = 0; i < data.size(); i++) data[i] -= m_start[c][i];
+                if (data[2] == 0) continue;
+                values[c] = static_cast<double>(data[0]) * static_cast<double>(data[1]) / static_cast<double>(data[2]);
+            }
+#endif
+            return values;
+        }
+
+    private:
+        std::array<int, COUNTER_COUNT> m_fds;
+        //value, time enabled, time running at start()
+        std::array<std::array<uint64_t, 3>, COUNTER_COUNT> m_start{};
+    };
+
+    //p in [0, 1], linear interpolation between the closest ranks
+    inline double Percentile(std::vector<double> values, double p)
+    {
+        if (values.empty()) return 0;
+        std::sort(values.begin(), values.end());
+        double rank = p * static_cast<double>(values.size() - 1);
+        size_t lo = static_cast<size_t>(rank);
+        size_t hi = std::min(lo + 1, values.size() - 1);
+        return values[lo] + (values[hi] - values[lo]) * (rank - static_cast<double>(lo));
+    }
+
+    struct BenchmarkOptions
+    {
+        int warmups = 2;
+        int repetitions = 11;
+    };
+
+    //one entry per measured repetition
+    struct BenchmarkResult
+    {
+        std::vector<double> times_us;
+        std::array<std::vector<double>, COUNTER_COUNT> counters;
+
+        double median() const { return Percentile(times_us, 0.5); }
+        double percentile(double p) const { return Percentile(times_us, p); }
+
+        std::optional<double> counterMedian(Counter c) const
+        {
+            const auto& values = counters[static_cast<size_t>(c)];
+            if (values.empty()) return std::nullopt;
+            return Percentile(values, 0.5);
+        }
+    };
+
+    //setup runs before every repetition outside the measured region (e.g. copying the input), run is measured.
+    //warmup repetitions run the same way but aren't recorded
+    template <typename Setup, typename Run>
+    BenchmarkResult Measure(Setup setup, Run run, const BenchmarkOptions& options = {})
+    {
+        PerfCounters perf;
+        BenchmarkResult result;
+        for (int rep = -options.warmups; rep < options.repetitions; rep++)
+        {
+            setup();
+            perf.start();
+            auto start = std::chrono::steady_clock::now();
+            run();
+            auto end = std::chrono::steady_clock::now();
+            CounterValues values = perf.stop();
+            if (rep < 0) continue;
+
+            result.times_us.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+            for (size_t c = 0; c < COUNTER_COUNT; c++)
+                if (values[c]) result.counters[c].push_back(*values[c]);
+        }
+        return result;
+    }
+
+    //"name: median 123 μs (p10 120, p90 130), cycles 4.5e+05, ..." with only the counters that were read
+    inline void PrintResult(std::ostream& out, std::string_view name, const BenchmarkResult& result)
+    {
+        out << "  " << name << ": median " << result.median() << " μs (p10 " << result.percentile(0.1)
+            << ", p90 " << result.percentile(0.9) << ")";
+        for (size_t c = 0; c < COUNTER_COUNT; c++)
+        {
+            if (auto value = result.counterMedian(static_cast<Counter>(c)))
+                out << ", " << COUNTER_NAMES[c] << " " << *value;
+        }
+        out << "\n";
+    }
+}
@@ -0,0 +1,285 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "multiway_merge.hpp"
+#include "sort.hpp"
+
+namespace val
+{
+    struct ExternalSortOptions
+    {
+        //bytes of records held in memory while generating runs, merge buffers are carved out of it too
+        size_t memoryBudget = size_t(256) << 20;
+        //bytes per single read or write
+        size_t ioBlockSize = size_t(1) << 20;
+        //read the next block / write the previous block in the background while the merge goes on
+        bool asyncIO = false;
+        //where the sorted runs are kept, empty means the system temp directory
+        std::filesystem::path tempDir;
+    };
+
+    namespace external
+    {
+        //sorted run on disk, removed when it goes out of scope
+        class RunFile
+        {
+        public:
+            explicit RunFile(const std::filesystem::path& dir)
+            {
+                static std::mt19937_64 gen(std::random_device{}());
+                static std::mutex genMutex;
+                std::lock_guard lock(genMutex);
+                m_path = dir / ("val_sort_run_" + std::to_string(gen()) + ".bin");
+            }
+            ~RunFile()
+            {
+                std::error_code ec;
+                std::filesystem::remove(m_path, ec);
+            }
+            RunFile(const RunFile&) = delete;
+            RunFile& operator=(const RunFile&) = delete;
+
+            const std::filesystem::path& path() const { return m_path; }
+
+        private:
+            std::filesystem::path m_path;
+        };
+
+        template <typename T>
+        size_t ReadRecords(std::istream& in, T* data, size_t count)
+        {
+            in.read(reinterpret_cast<char*>(data), static_cast<std::streamsize>(count * sizeof(T)));
+            size_t bytes = static_cast<size_t>(in.gcount());
+            if (bytes % sizeof(T) != 0)
+                throw std::runtime_error("input size is not a multiple of the record size");
+            return bytes / sizeof(T);
+        }
+
+        template <typename T>
+        void WriteRecords(std::ostream& out, const T* data, size_t count)
+        {
+            out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(count * sizeof(T)));
+            if (!out) throw std::runtime_error("failed to write sorted records");
+        }
+
+        //sequential block reader, with async the next block is read while the current one is consumed
+        template <typename T>
+        class BlockReader
+        {
+        public:
+            BlockReader(const std::filesystem::path& path, size_t blockRecords, bool async)
+                : m_file(path, std::ios::binary)
+                , m_front(blockRecords)
+                , m_async(async)
+            {
+                if (!m_file) throw std::runtime_error("failed to open run " + path.string());
+                if (m_async)
+                {
+                    m_back.resize(blockRecords);
+                    m_pending = std::async(std::launch::async, [this] { return readBlock(m_back); });
+                }
+                refill();
+            }
+
+            //nullptr once the run is exhausted
+            const T* current() const { return m_pos < m_size ? m_front.data() + m_pos : nullptr; }
+
+            void advance()
+            {
+                if (++m_pos == m_size) refill();
+            }
+
+        private:
+            size_t readBlock(std::vector<T>& block) { return ReadRecords(m_file, block.data(), block.size()); }
+
+            void refill()
+            {
+                m_pos = 0;
+                if (!m_async)
+                {
+                    m_size = readBlock(m_front);
+                    return;
+                }
+                m_size = m_pending.get();
+                std::swap(m_front, m_back);
+                if (m_size > 0)
+                    m_pending = std::async(std::launch::async, [this] { return readBlock(m_back); });
+            }
+
+            std::ifstream m_file;
+            std::vector<T> m_front;
+            std::vector<T> m_back;
+            size_t m_pos = 0;
+            size_t m_size = 0;
+            bool m_async;
+            //declared last so a pending read finishes before the buffers and the file go away
+            std::future<size_t> m_pending;
+        };
+
+        //buffered writer, with async the full block is written while the next one is filled
+        template <typename T>
+        class BlockWriter
+        {
+        public:
+            BlockWriter(std::ostream& out, size_t blockRecords, bool async)
+                : m_out(out)
+                , m_async(async)
+            {
+                m_front.reserve(blockRecords);
+                if (m_async) m_back.reserve(blockRecords);
+            }
+
+            ~BlockWriter()
+            {
+                if (m_pending.valid()) m_pending.wait();
+            }
+
+            void push(const T& record)
+            {
+                m_front.push_back(record);
+                if (m_front.size() == m_front.capacity()) flush();
+            }
+
+            //writes everything out, rethrows write errors
+            void finish()
+            {
+                flush();
+                if (m_pending.valid()) m_pending.get();
+                m_out.flush();
+            }
+
+        private:
+            void flush()
+            {
+                if (m_front.empty()) return;
+                if (!m_async)
+                {
+                    WriteRecords(m_out, m_front.data(), m_front.size());
+                    m_front.clear();
+                    return;
+                }
+                if (m_pending.valid()) m_pending.get();
+                std::swap(m_front, m_back);
+                m_front.clear();
+                m_pending = std::async(std::launch::async, [this] { WriteRecords(m_out, m_back.data(), m_back.size()); });
+            }
+
+            std::ostream& m_out;
+            std::vector<T> m_front;
+            std::vector<T> m_back;
+            bool m_async;
+            std::future<void> m_pending;
+        };
+
+        template <typename T, typename Compare>
+        void MergeRuns(const std::vector<const RunFile*>& runs, std::ostream& out, Compare comp,
+                       size_t blockRecords, bool async)
+        {
+            //readers hand out pointers into their buffers and to themselves for async reads, so they don't move
+            std::vector<std::unique_ptr<BlockReader<T>>> readers;
+            std::vector<const T*> heads;
+            for (const RunFile* run : runs)
+            {
+                readers.push_back(std::make_unique<BlockReader<T>>(run->path(), blockRecords, async));
+                heads.push_back(readers.back()->current());
+            }
+
+            LoserTree<T, Compare> tree(readers.size(), comp);
+            tree.init(heads);
+            BlockWriter<T> writer(out, blockRecords, async);
+            while (!tree.empty())
+            {
+                writer.push(tree.top());
+                BlockReader<T>& reader = *readers[tree.winner()];
+                reader.advance();
+                tree.replaceTop(reader.current());
+            }
+            writer.finish();
+        }
+    } //namespace external
+
+    //sorts fixed size binary records (trivially copyable T) from in to out using at most about memoryBudget bytes:
+    //budget sized chunks are sorted with val::sort into runs on disk, then merged k at a time
+    template <typename T, typename Compare>
+    void external_sort(std::istream& in, std::ostream& out, Compare comp, const ExternalSortOptions& options = {})
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "external_sort works on raw binary records");
+        using namespace external;
+
+        size_t chunkRecords = std::max<size_t>(options.memoryBudget / sizeof(T), 1);
+        size_t blockRecords = std::max<size_t>(options.ioBlockSize / sizeof(T), 1);
+        std::filesystem::path dir = options.tempDir.empty() ? std::filesystem::temp_directory_path() : options.tempDir;
+
+        std::vector<std::unique_ptr<RunFile>> runs;
+        {
+            //not value initialized, pages of a big budget are only touched if the input is that big
+            auto chunk = std::make_unique_for_overwrite<T[]>(chunkRecords);
+            while (true)
+            {
+                size_t count = ReadRecords(in, chunk.get(), chunkRecords);
+                if (count == 0) break;
+                val::sort(chunk.get(), chunk.get() + count, comp);
+
+                //everything fit into memory, no need for the disk
+                if (runs.empty() && count < chunkRecords)
+                {
+                    WriteRecords(out, chunk.get(), count);
+                    out.flush();
+                    return;
+                }
+
+                runs.push_back(std::make_unique<RunFile>(dir));
+                std::ofstream runOut(runs.back()->path(), std::ios::binary);
+                if (!runOut) throw std::runtime_error("failed to create run " + runs.back()->path().string());
+                WriteRecords(runOut, chunk.get(), count);
+            }
+        }
+        if (in.bad()) throw std::runtime_error("failed to read records");
+
+        //every input and the output need a block (two with async), so the budget limits the fan-in
+        size_t buffersPerStream = options.asyncIO ? 2 : 1;
+        size_t fanIn = std::max<size_t>(options.memoryBudget / (options.ioBlockSize * buffersPerStream), 3) - 1;
+
+        while (runs.size() > fanIn)
+        {
+            std::vector<std::unique_ptr<RunFile>> merged;
+            for (size_t i = 0; i < runs.size(); i += fanIn)
+            {
+                std::vector<const RunFile*> group;
+                for (size_t j = i; j < std::min(i + fanIn, runs.size()); j++) group.push_back(runs[j].get());
+
+                merged.push_back(std::make_unique<RunFile>(dir));
+                std::ofstream runOut(merged.back()->path(), std::ios::binary);
+                if (!runOut) throw std::runtime_error("failed to create run " + merged.back()->path().string());
+                MergeRuns<T>(group, runOut, comp, blockRecords, options.asyncIO);
+            }
+            runs = std::move(merged);
+        }
+
+        std::vector<const RunFile*> last;
+        for (const auto& run : runs) last.push_back(run.get());
+        MergeRuns<T>(last, out, comp, blockRecords, options.asyncIO);
+    }
+
+    template <typename T, typename Compare>
+    void external_sort(const std::filesystem::path& input, const std::filesystem::path& output, Compare comp,
+                       const ExternalSortOptions& options = {})
+    {
+        std::ifstream in(input, std::ios::binary);
+        if (!in) throw std::runtime_error("failed to open " + input.string());
+        std::ofstream out(output, std::ios::binary);
+        if (!out) throw std::runtime_error("failed to open " + output.string());
+        external_sort<T>(in, out, comp, options);
+    }
+}
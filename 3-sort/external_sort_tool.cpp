@@ -0,0 +1,94 @@
+//command line front end for val::external_sort
+//usage: external_sort <input> <output> [--type i32|i64|u32|u64|f32|f64] [--memory MiB] [--block KiB] [--async] [--tmp dir]
+#include <charconv>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string_view>
+#include "external_sort.hpp"
+
+namespace
+{
+    void PrintUsage()
+    {
+        std::cerr << "usage: external_sort <input> <output> [--type i32|i64|u32|u64|f32|f64]"
+                     " [--memory MiB] [--block KiB] [--async] [--tmp dir]\n";
+    }
+
+    bool ParseSize(std::string_view text, size_t& value)
+    {
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+        return ec == std::errc() && ptr == text.data() + text.size() && value > 0;
+    }
+
+    template <typename T>
+    void Run(const char* input, const char* output, const val::ExternalSortOptions& options)
+    {
+        val::external_sort<T>(input, output, std::less<T>(), options);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    std::string_view type = "i32";
+    val::ExternalSortOptions options;
+    for (int i = 3; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        size_t value = 0;
+        if (arg == "--async")
+        {
+            options.asyncIO = true;
+        }
+        else if (arg == "--type" && i + 1 < argc)
+        {
+            type = argv[++i];
+        }
+        else if (arg == "--memory" && i + 1 < argc && ParseSize(argv[i + 1], value))
+        {
+            options.memoryBudget = value << 20;
+            i++;
+        }
+        else if (arg == "--block" && i + 1 < argc && ParseSize(argv[i + 1], value))
+        {
+            options.ioBlockSize = value << 10;
+            i++;
+        }
+        else if (arg == "--tmp" && i + 1 < argc)
+        {
+            options.tempDir = argv[++i];
+        }
+        else
+        {
+            PrintUsage();
+            return 2;
+        }
+    }
+
+    try
+    {
+        if (type == "i32") Run<int32_t>(argv[1], argv[2], options);
+        else if (type == "i64") Run<int64_t>(argv[1], argv[2], options);
+        else if (type == "u32") Run<uint32_t>(argv[1], argv[2], options);
+        else if (type == "u64") Run<uint64_t>(argv[1], argv[2], options);
+        else if (type == "f32") Run<float>(argv[1], argv[2], options);
+        else if (type == "f64") Run<double>(argv[1], argv[2], options);
+        else
+        {
+            PrintUsage();
+            return 2;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,11 +1,30 @@
 #include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cmath>
 #include <vector>
 #include <iostream>
 #include <random>
 #include <iomanip>
 #include <valarray>
+#include <deque>
+#include <map>
 #include <gtest/gtest.h>
 #include "sort.hpp"
+#include "stable_sort.hpp"
+#include "sorted_merge.hpp"
+#include "parallel_sort.hpp"
+#include "external_sort.hpp"
+#include "shm_sort.hpp"
+#include "select.hpp"
+#include "sort_by_key.hpp"
+#include "sort_unique.hpp"
+#include "argsort.hpp"
+#include "network_sort.hpp"
+#include "batch_sort.hpp"
+#include "sort_async.hpp"
+#include "bench_harness.hpp"
+#include "../2-array/valarray.hpp"
 
 template<typename T>
 std::vector<T> generateRandomVector(size_t size, T min_val, T max_val)
@@ -110,6 +129,100 @@ TEST_F(SortTypeTest, GreaterComparator) {
     EXPECT_TRUE(std::is_sorted(v.begin(), v.end(), std::greater<int>()));
 }
 
+// Iterator and range tests
+class SortRangeTest : public ::testing::Test {};
+
+TEST_F(SortRangeTest, Deque) {
+    auto v = generateRandomVector<int>(10000, -10000, 10000);
+    std::deque<int> d(v.begin(), v.end());
+    val::sort(d.begin(), d.end(), std::less<int>());
+    EXPECT_TRUE(std::is_sorted(d.begin(), d.end()));
+    std::deque<int> r(v.begin(), v.end());
+    val::sort(r, std::greater<int>());
+    EXPECT_TRUE(std::is_sorted(r.begin(), r.end(), std::greater<int>()));
+}
+
+TEST_F(SortRangeTest, VectorRangeAndProjection) {
+    auto v = generateRandomVector<int>(1000, -1000, 1000);
+    val::sort(v);
+    EXPECT_TRUE(std::is_sorted(v.begin(), v.end()));
+
+    struct Record
+    {
+        std::string name;
+        int score;
+    };
+    std::vector<Record> records = {{"c", 3}, {"a", 1}, {"d", 4}, {"b", 2}};
+    val::sort(records, std::greater<>(), &Record::score);
+    EXPECT_EQ(records[0].name, "d");
+    EXPECT_EQ(records[3].name, "a");
+}
+
+TEST_F(SortRangeTest, CustomArray) {
+    Array<int> arr;
+    for (int x : {3, 2, 5, 4, 1, 9, 2, 3, 4}) arr.insert(x);
+    val::sort(arr);
+    std::vector<int> sorted;
+    for (int x : arr) sorted.push_back(x);
+    EXPECT_EQ(sorted, (std::vector<int>{1, 2, 2, 3, 3, 4, 4, 5, 9}));
+}
+
+// Engine settings tests
+class SortTuningTest : public ::testing::Test {};
+
+TEST_F(SortTuningTest, LomutoSchemeAndThresholds) {
+    auto v = generateRandomVector<int>(50000, -50000, 50000);
+    for (size_t threshold : {size_t(1), size_t(16), size_t(300)})
+    {
+        auto h = v;
+        val::HybridSortNoTailRecursion<val::PartitionScheme::Hoare>(h.data(), h.data() + h.size(), std::less<int>(), threshold);
+        EXPECT_TRUE(std::is_sorted(h.begin(), h.end()));
+        auto l = v;
+        val::HybridSortNoTailRecursion<val::PartitionScheme::Lomuto>(l.data(), l.data() + l.size(), std::less<int>(), threshold);
+        EXPECT_TRUE(std::is_sorted(l.begin(), l.end()));
+    }
+}
+
+TEST_F(SortTuningTest, LomutoAllEqual) {
+    //would be quadratic without grouping the keys equal to the pivot
+    std::vector<int> v(200000, 7);
+    v[100] = 3;
+    val::HybridSortNoTailRecursion<val::PartitionScheme::Lomuto>(v.data(), v.data() + v.size(), std::less<int>(), 16);
+    EXPECT_TRUE(std::is_sorted(v.begin(), v.end()));
+}
+
+TEST_F(SortTuningTest, BranchlessLomutoScheme) {
+    using Scheme = val::PartitionScheme;
+    auto v = generateRandomVector<int64_t>(100000, -1000000, 1000000);
+    for (size_t threshold : {size_t(1), size_t(16), size_t(200)})
+    {
+        auto b = v;
+        val::HybridSortNoTailRecursion<Scheme::BranchlessLomuto>(b.data(), b.data() + b.size(), std::less<>(), threshold);
+        EXPECT_TRUE(std::is_sorted(b.begin(), b.end()));
+    }
+
+    //few distinct keys and all equal keys still group the pivot's duplicates
+    auto few = generateRandomVector<int>(100000, 0, 3);
+    val::HybridSortNoTailRecursion<Scheme::BranchlessLomuto>(few.data(), few.data() + few.size(), std::less<int>(), 16);
+    EXPECT_TRUE(std::is_sorted(few.begin(), few.end()));
+    std::vector<double> same(100000, 1.5);
+    val::HybridSortNoTailRecursion<Scheme::BranchlessLomuto>(same.data(), same.data() + same.size(), std::less<double>(), 16);
+    EXPECT_TRUE(std::is_sorted(same.begin(), same.end()));
+
+    //types that aren't cheap to copy take the plain Lomuto kernel
+    std::vector<std::string> words = {"pear", "fig", "apple", "kiwi", "date", "banana", "cherry", "fig"};
+    val::HybridSortNoTailRecursion<Scheme::BranchlessLomuto>(words.begin(), words.end(), std::less<>(), 1);
+    EXPECT_TRUE(std::is_sorted(words.begin(), words.end()));
+}
+
+TEST_F(SortTuningTest, BranchlessPartitionSplits) {
+    std::vector<int> v = {5, 9, 1, 7, 3, 8, 2, 6, 4};
+    auto q = val::BranchlessPartition(v.begin(), v.end(), std::less<int>());
+    for (auto it = v.begin(); it != q; ++it) EXPECT_LT(*it, *q);
+    for (auto it = q + 1; it != v.end(); ++it) EXPECT_GE(*it, *q);
+    EXPECT_EQ(*q, 4); //median of 5, 3, 4
+}
+
 // Large Random Data Tests
 class SortLargeDataTest : public ::testing::Test {};
 
@@ -151,30 +264,1110 @@ TEST_F(SortLargeDataTest, ManyDuplicates) {
 
 #pragma endregion BASIC_TESTS
 
+#pragma region SIMD_TESTS
+class SimdSortTest : public ::testing::Test
+{
+protected:
+    template <typename T>
+    void CheckAllSizes(T min_val, T max_val)
+    {
+        if (!val::SimdSortAvailable()) GTEST_SKIP() << "no AVX2 on this CPU";
+        for (size_t size = 0; size <= val::SIMD_SORT_MAX; ++size)
+        {
+            auto v = generateRandomVector<T>(size, min_val, max_val);
+            auto expected = v;
+            std::sort(expected.begin(), expected.end());
+            val::SimdSort(v.data(), v.data() + v.size());
+            EXPECT_EQ(v, expected) << "size " << size;
+        }
+    }
+};
+
+TEST_F(SimdSortTest, Int32AllSizes) {
+    CheckAllSizes<int32_t>(-1000, 1000);
+}
+
+TEST_F(SimdSortTest, Int64AllSizes) {
+    CheckAllSizes<int64_t>(-1000000000000LL, 1000000000000LL);
+}
+
+TEST_F(SimdSortTest, ExtremeValues) {
+    if (!val::SimdSortAvailable()) GTEST_SKIP() << "no AVX2 on this CPU";
+    //max is also used as padding
+    std::vector<int> v = {std::numeric_limits<int>::max(), 0, std::numeric_limits<int>::min(), -1,
+                          std::numeric_limits<int>::max(), 5, std::numeric_limits<int>::min()};
+    auto expected = v;
+    std::sort(expected.begin(), expected.end());
+    val::SimdSort(v.data(), v.data() + v.size());
+    EXPECT_EQ(v, expected);
+}
+
+TEST_F(SimdSortTest, HybridSortInt64) {
+    auto v = generateRandomVector<int64_t>(100000, -100000, 100000);
+    val::sort(v.data(), v.data() + v.size(), std::less<>());
+    EXPECT_TRUE(std::is_sorted(v.begin(), v.end()));
+}
+#pragma endregion SIMD_TESTS
+
+#pragma region STABLE_TESTS
+class StableSortTest : public ::testing::Test
+{
+protected:
+    //key and original position, only the key is compared
+    struct Item
+    {
+        int key;
+        int pos;
+    };
+
+    static std::vector<Item> MakeItems(const std::vector<int>& keys)
+    {
+        std::vector<Item> items;
+        for (int i = 0; i < static_cast<int>(keys.size()); ++i) items.push_back({keys[i], i});
+        return items;
+    }
+
+    static void ExpectStablySorted(const std::vector<Item>& items)
+    {
+        for (size_t i = 1; i < items.size(); ++i)
+        {
+            ASSERT_LE(items[i - 1].key, items[i].key) << "at " << i;
+            if (items[i - 1].key == items[i].key)
+            {
+                ASSERT_LT(items[i - 1].pos, items[i].pos) << "at " << i;
+            }
+        }
+    }
+
+    static bool KeyLess(const Item& a, const Item& b) { return a.key < b.key; }
+};
+
+TEST_F(StableSortTest, Basic) {
+    std::vector<int> v = {5, 2, 8, 2, 9, 1, 5, 5, 2};
+    val::stable_sort(v.data(), v.data() + v.size(), std::less<int>());
+    std::vector<int> expected = {1, 2, 2, 2, 5, 5, 5, 8, 9};
+    EXPECT_EQ(v, expected);
+}
+
+TEST_F(StableSortTest, EmptyAndSingle) {
+    std::vector<int> v;
+    val::stable_sort(v.data(), v.data() + v.size(), std::less<int>());
+    EXPECT_TRUE(v.empty());
+    v = {42};
+    val::stable_sort(v.data(), v.data() + v.size(), std::less<int>());
+    EXPECT_EQ(v[0], 42);
+}
+
+TEST_F(StableSortTest, KeepsEqualKeysInOrder) {
+    auto items = MakeItems(generateRandomVector<int>(100000, 0, 100));
+    val::stable_sort(items.data(), items.data() + items.size(), KeyLess);
+    ExpectStablySorted(items);
+}
+
+TEST_F(StableSortTest, DescendingRunsWithDuplicates) {
+    //descending runs are reversed, equal keys inside them must not be
+    std::vector<int> keys;
+    for (int block = 0; block < 100; ++block)
+        for (int k = 1000; k > 0; --k) keys.push_back(k / 3);
+    auto items = MakeItems(keys);
+    val::stable_sort(items.data(), items.data() + items.size(), KeyLess);
+    ExpectStablySorted(items);
+}
+
+TEST_F(StableSortTest, InPlaceFallback) {
+    auto items = MakeItems(generateRandomVector<int>(20000, 0, 50));
+    val::stable_sort(items.data(), items.data() + items.size(), KeyLess, 0);
+    ExpectStablySorted(items);
+}
+
+TEST_F(StableSortTest, NearlySortedAndStrings) {
+    std::vector<int> v(100000);
+    std::iota(v.begin(), v.end(), 0);
+    std::mt19937 gen(42);
+    std::uniform_int_distribution<> dis(0, 99999);
+    for (int i = 0; i < 1000; ++i) std::swap(v[dis(gen)], v[dis(gen)]);
+    val::stable_sort(v.data(), v.data() + v.size(), std::less<int>());
+    EXPECT_TRUE(std::is_sorted(v.begin(), v.end()));
+
+    std::vector<std::string> s = {"zebra", "apple", "banana", "cherry", "date", "apple"};
+    val::stable_sort(s.data(), s.data() + s.size(), std::less<std::string>());
+    EXPECT_TRUE(std::is_sorted(s.begin(), s.end()));
+}
+
+class SortedMergeTest : public StableSortTest {};
+
+TEST_F(SortedMergeTest, BatchIntoSortedVector) {
+    auto base = generateRandomVector<int>(100000, 0, 1000000);
+    std::sort(base.begin(), base.end());
+    auto batch = generateRandomVector<int>(500, 0, 1000000);
+    auto expected = base;
+    expected.insert(expected.end(), batch.begin(), batch.end());
+    std::sort(expected.begin(), expected.end());
+
+    val::merge_into_sorted(base, batch);
+    EXPECT_EQ(base, expected);
+}
+
+TEST_F(SortedMergeTest, StableAndCheap) {
+    auto keys = generateRandomVector<int>(100000, 0, 1000);
+    std::sort(keys.begin(), keys.end());
+    auto batch = generateRandomVector<int>(100, 0, 1000);
+    keys.insert(keys.end(), batch.begin(), batch.end());
+    auto items = MakeItems(keys);
+
+    size_t comparisons = 0;
+    auto counting = [&comparisons](const Item& a, const Item& b) { comparisons++; return a.key < b.key; };
+    val::merge_into_sorted(items.data(), items.data() + 100000, items.data() + items.size(), counting);
+    ExpectStablySorted(items);
+    //galloping: about k log(n / k) comparisons instead of one per element
+    EXPECT_LT(comparisons, 20000u);
+}
+
+TEST_F(SortedMergeTest, SortAppendFindsPrefix) {
+    std::vector<int> v(50000);
+    std::iota(v.begin(), v.end(), 0);
+    for (int x : {-5, 70000, 123, 123, 49999}) v.push_back(x);
+    val::sort_append(v.data(), v.data() + v.size(), std::less<int>());
+    EXPECT_TRUE(std::is_sorted(v.begin(), v.end()));
+    EXPECT_EQ(v.size(), 50005u);
+
+    //no sorted prefix at all still sorts
+    auto r = generateRandomVector<int>(1000, -100, 100);
+    val::sort_append(r.data(), r.data() + r.size(), std::less<int>());
+    EXPECT_TRUE(std::is_sorted(r.begin(), r.end()));
+}
+
+TEST_F(SortedMergeTest, InPlaceWithoutBuffer) {
+    auto keys = generateRandomVector<int>(20000, 0, 50);
+    std::sort(keys.begin(), keys.begin() + 15000);
+    auto items = MakeItems(keys);
+    val::merge_into_sorted(items.data(), items.data() + 15000, items.data() + items.size(), KeyLess, 0);
+    ExpectStablySorted(items);
+}
+#pragma endregion STABLE_TESTS
+
+#pragma region PARALLEL_TESTS
+class ParallelSortTest : public StableSortTest {};
+
+TEST_F(ParallelSortTest, StableWithUnevenChunks) {
+    for (unsigned threads : {2u, 3u, 4u, 7u})
+    {
+        auto items = MakeItems(generateRandomVector<int>(200003, 0, 1000));
+        val::parallel_stable_sort(items.data(), items.data() + items.size(), KeyLess, threads);
+        ExpectStablySorted(items);
+    }
+}
+
+TEST_F(ParallelSortTest, AllEqualKeys) {
+    //every split lands inside the same run of equal keys
+    auto items = MakeItems(std::vector<int>(100000, 7));
+    val::parallel_stable_sort(items.data(), items.data() + items.size(), KeyLess, 4);
+    ExpectStablySorted(items);
+}
+
+TEST_F(ParallelSortTest, SmallInputFallsBack) {
+    std::vector<int> v = {3, 7, 1, 9, 2, 8, 5, 4, 6};
+    val::parallel_stable_sort(v.data(), v.data() + v.size(), std::less<int>(), 8);
+    EXPECT_TRUE(std::is_sorted(v.begin(), v.end()));
+}
+
+TEST_F(ParallelSortTest, MultiwayMergeKeepsSourceOrder) {
+    std::vector<int> a = {1, 3, 5, 5}, b = {2, 5, 6}, c = {}, d = {0, 5};
+    std::vector<val::SortedSequence<int>> seqs = {
+        {a.data(), a.data() + a.size()}, {b.data(), b.data() + b.size()},
+        {c.data(), c.data() + c.size()}, {d.data(), d.data() + d.size()}};
+    std::vector<int> out(9);
+    EXPECT_EQ(val::MultiwayMerge(seqs, out.data(), std::less<int>()), out.data() + out.size());
+    EXPECT_EQ(out, (std::vector<int>{0, 1, 2, 3, 5, 5, 5, 5, 6}));
+
+    //the 5s go a, a, b, d: a split at rank 6 takes both of a's and nothing else
+    auto splits = val::MultiwaySplit(seqs, 6, std::less<int>());
+    EXPECT_EQ(splits, (std::vector<size_t>{4, 1, 0, 1}));
+}
+
+class SampleSortTest : public ::testing::Test {};
+
+TEST_F(SampleSortTest, RandomMatchesStdSort) {
+    for (unsigned threads : {1u, 3u, 4u})
+    {
+        auto v = generateRandomVector<int>(300007, -1000000, 1000000);
+        auto expected = v;
+        std::sort(expected.begin(), expected.end());
+        val::sample_sort(v.data(), v.data() + v.size(), std::less<int>(), threads);
+        EXPECT_EQ(v, expected);
+    }
+}
+
+TEST_F(SampleSortTest, SkewedKeys) {
+    //90% of the keys are one value: it gets its own equality bucket
+    std::mt19937 gen(7);
+    std::vector<int64_t> v(400000);
+    for (auto& x : v) x = (gen() % 10 == 0) ? static_cast<int64_t>(gen()) : 42;
+    auto expected = v;
+    std::sort(expected.begin(), expected.end());
+    val::sample_sort(v.data(), v.data() + v.size(), std::less<int64_t>(), 4);
+    EXPECT_EQ(v, expected);
+}
+
+TEST_F(SampleSortTest, FewDistinctAndSortedInputs) {
+    auto few = generateRandomVector<int>(200000, 0, 3);
+    val::sample_sort(few.data(), few.data() + few.size(), std::less<int>(), 4);
+    EXPECT_TRUE(std::is_sorted(few.begin(), few.end()));
+
+    std::vector<int> desc(200000);
+    for (size_t i = 0; i < desc.size(); i++) desc[i] = static_cast<int>(desc.size() - i);
+    val::sample_sort(desc.data(), desc.data() + desc.size(), std::less<int>(), 4);
+    EXPECT_TRUE(std::is_sorted(desc.begin(), desc.end()));
+}
+
+TEST_F(SampleSortTest, StringsWithCustomComparator) {
+    std::vector<std::string> v(100000);
+    std::mt19937 gen(3);
+    for (auto& s : v) s = "k" + std::to_string(gen() % 5000);
+    auto expected = v;
+    auto longerFirst = [](const std::string& a, const std::string& b)
+    {
+        return a.size() != b.size() ? a.size() > b.size() : a < b;
+    };
+    std::sort(expected.begin(), expected.end(), longerFirst);
+    val::sample_sort(v.data(), v.data() + v.size(), longerFirst, 2);
+    EXPECT_EQ(v, expected);
+}
+#pragma endregion PARALLEL_TESTS
+
+#pragma region EXTERNAL_TESTS
+class ExternalSortTest : public ::testing::Test
+{
+protected:
+    static std::vector<int> SortThroughStreams(const std::vector<int>& v, const val::ExternalSortOptions& options)
+    {
+        std::stringstream in(std::string(reinterpret_cast<const char*>(v.data()), v.size() * sizeof(int)));
+        std::stringstream out;
+        val::external_sort<int>(in, out, std::less<int>(), options);
+        std::string bytes = out.str();
+        std::vector<int> result(bytes.size() / sizeof(int));
+        std::memcpy(result.data(), bytes.data(), result.size() * sizeof(int));
+        return result;
+    }
+};
+
+TEST_F(ExternalSortTest, FitsInMemory) {
+    auto v = generateRandomVector<int>(1000, -1000, 1000);
+    auto expected = v;
+    std::sort(expected.begin(), expected.end());
+    EXPECT_EQ(SortThroughStreams(v, {}), expected);
+}
+
+TEST_F(ExternalSortTest, MultiPassMerge) {
+    //1024 records per run and a fan-in of 15 means ~100 runs need two merge passes
+    auto v = generateRandomVector<int>(100000, -100000, 100000);
+    auto expected = v;
+    std::sort(expected.begin(), expected.end());
+    val::ExternalSortOptions options;
+    options.memoryBudget = 4096;
+    options.ioBlockSize = 256;
+    EXPECT_EQ(SortThroughStreams(v, options), expected);
+}
+
+TEST_F(ExternalSortTest, AsyncIO) {
+    auto v = generateRandomVector<int>(50000, 0, 100);
+    auto expected = v;
+    std::sort(expected.begin(), expected.end());
+    val::ExternalSortOptions options;
+    options.memoryBudget = 16384;
+    options.ioBlockSize = 512;
+    options.asyncIO = true;
+    EXPECT_EQ(SortThroughStreams(v, options), expected);
+}
+
+TEST_F(ExternalSortTest, TruncatedRecordThrows) {
+    std::stringstream in("abcdefg");
+    std::stringstream out;
+    EXPECT_THROW(val::external_sort<int>(in, out, std::less<int>()), std::runtime_error);
+}
+#pragma endregion EXTERNAL_TESTS
+
+#pragma region SHM_SORT_TESTS
+class ShmSortTest : public ::testing::Test
+{
+protected:
+    static std::string SegmentName(const char* test)
+    {
+        return std::string("/val_sort_") + test + "_" + std::to_string(getpid());
+    }
+
+    static val::SharedSortSegment<int64_t> Fill(const std::string& name, const std::vector<int64_t>& v)
+    {
+        auto segment = val::SharedSortSegment<int64_t>::create(name, v.size());
+        std::copy(v.begin(), v.end(), segment.data());
+        return segment;
+    }
+};
+
+TEST_F(ShmSortTest, ForkedWorkers) {
+    for (unsigned processes : {1u, 2u, 3u, 8u})
+    {
+        auto v = generateRandomVector<int64_t>(300000, -1000000, 1000000);
+        auto segment = Fill(SegmentName("forked"), v);
+        val::shm_sort(segment, processes, std::less<int64_t>());
+        std::sort(v.begin(), v.end());
+        EXPECT_TRUE(std::equal(v.begin(), v.end(), segment.begin(), segment.end())) << processes << " processes";
+    }
+
+    //few distinct keys, the merge splits fall inside runs of equal keys
+    auto few = generateRandomVector<int64_t>(200000, 0, 3);
+    auto segment = Fill(SegmentName("few"), few);
+    val::shm_sort(segment, 4, std::greater<int64_t>());
+    std::sort(few.begin(), few.end(), std::greater<int64_t>());
+    EXPECT_TRUE(std::equal(few.begin(), few.end(), segment.begin(), segment.end()));
+}
+
+TEST_F(ShmSortTest, WorkersOpenSegmentByName) {
+    auto v = generateRandomVector<int64_t>(100000, -1000, 1000);
+    std::string name = SegmentName("open");
+    auto segment = Fill(name, v);
+
+    //every worker maps the segment on its own, as separate processes would
+    constexpr unsigned WORKERS = 3;
+    val::ParallelFor(WORKERS, [&](unsigned rank)
+    {
+        auto mine = val::SharedSortSegment<int64_t>::open(name);
+        val::shm_sort_worker(mine, rank, WORKERS, std::less<int64_t>());
+    });
+    std::sort(v.begin(), v.end());
+    EXPECT_TRUE(std::equal(v.begin(), v.end(), segment.begin(), segment.end()));
+
+    EXPECT_THROW(val::SharedSortSegment<int32_t>::open(name), std::runtime_error);
+    EXPECT_THROW(val::SharedSortSegment<int64_t>::open(name + "_missing"), std::system_error);
+    EXPECT_THROW(val::SharedSortSegment<int64_t>::create(name, 10), std::system_error);
+}
+
+TEST_F(ShmSortTest, FailedWorkerAbortsTheOthers) {
+    auto v = generateRandomVector<int64_t>(200000, 0, 1000000);
+    v[123] = -1;
+    auto segment = Fill(SegmentName("abort"), v);
+    auto throwing = [](int64_t a, int64_t b)
+    {
+        if (a == -1 || b == -1) throw std::runtime_error("bad key");
+        return a < b;
+    };
+    EXPECT_THROW(val::shm_sort(segment, 4, throwing), std::runtime_error);
+
+    //a worker that dies without unwinding
+    auto crashing = [](int64_t a, int64_t b)
+    {
+        if (a == -1 || b == -1) _exit(3);
+        return a < b;
+    };
+    EXPECT_THROW(val::shm_sort(segment, 4, crashing), std::runtime_error);
+
+    //the elements are all still there and the segment can be sorted again
+    val::shm_sort(segment, 4, std::less<int64_t>());
+    std::sort(v.begin(), v.end());
+    EXPECT_TRUE(std::equal(v.begin(), v.end(), segment.begin(), segment.end()));
+}
+
+TEST_F(ShmSortTest, FailureDuringMergeKeepsTheElements) {
+    //the low 2 bits tag the worker chunk a key starts in, only the merge compares keys of different chunks
+    constexpr unsigned WORKERS = 4;
+    constexpr size_t SIZE = 200000;
+    auto v = generateRandomVector<int64_t>(SIZE, 0, 1000000);
+    for (size_t i = 0; i < SIZE; ++i) v[i] = v[i] * 4 + static_cast<int64_t>(i * WORKERS / SIZE);
+    auto sorted = v;
+    std::sort(sorted.begin(), sorted.end());
+    auto segment = Fill(SegmentName("merge_abort"), v);
+
+    //every worker process fails after part of its share is merged (the splits take a few thousand compares)
+    auto throwing = [](int64_t a, int64_t b)
+    {
+        static int crossChunk = 0;
+        if ((a & 3) != (b & 3) && ++crossChunk == 50000) throw std::runtime_error("bad key");
+        return a < b;
+    };
+    EXPECT_THROW(val::shm_sort(segment, WORKERS, throwing), std::runtime_error);
+    std::vector<int64_t> after(segment.begin(), segment.end());
+    std::sort(after.begin(), after.end());
+    EXPECT_EQ(after, sorted);
+
+    auto crashing = [](int64_t a, int64_t b)
+    {
+        static int crossChunk = 0;
+        if ((a & 3) != (b & 3) && ++crossChunk == 50000) _exit(3);
+        return a < b;
+    };
+    std::copy(v.begin(), v.end(), segment.begin());
+    EXPECT_THROW(val::shm_sort(segment, WORKERS, crashing), std::runtime_error);
+    after.assign(segment.begin(), segment.end());
+    std::sort(after.begin(), after.end());
+    EXPECT_EQ(after, sorted);
+
+    //workers without a parent process restore the data themselves, here exactly one thread fails
+    std::atomic<int> crossChunk = 0;
+    auto failOnce = [&crossChunk](int64_t a, int64_t b)
+    {
+        if ((a & 3) != (b & 3) && ++crossChunk == 50000) throw std::runtime_error("bad key");
+        return a < b;
+    };
+    std::copy(v.begin(), v.end(), segment.begin());
+    segment.reset();
+    EXPECT_THROW(val::ParallelFor(WORKERS, [&](unsigned rank) { val::shm_sort_worker(segment, rank, WORKERS, failOnce); }),
+                 std::runtime_error);
+    after.assign(segment.begin(), segment.end());
+    std::sort(after.begin(), after.end());
+    EXPECT_EQ(after, sorted);
+}
+#pragma endregion SHM_SORT_TESTS
+
+#pragma region SELECT_TESTS
+class SelectTest : public ::testing::Test
+{
+protected:
+    static void ExpectNth(std::vector<int> v, size_t n)
+    {
+        auto sorted = v;
+        std::sort(sorted.begin(), sorted.end());
+        val::nth_element(v.data(), v.data() + n, v.data() + v.size(), std::less<int>());
+        ASSERT_EQ(v[n], sorted[n]);
+        for (size_t i = 0; i < n; ++i) ASSERT_LE(v[i], v[n]);
+        for (size_t i = n + 1; i < v.size(); ++i) ASSERT_GE(v[i], v[n]);
+    }
+};
+
+TEST_F(SelectTest, NthElementRandom) {
+    auto v = generateRandomVector<int>(100000, -100000, 100000);
+    for (size_t n : {size_t(0), size_t(1), size_t(500), size_t(50000), size_t(99999)})
+        ExpectNth(v, n);
+}
+
+TEST_F(SelectTest, NthElementDuplicatesAndSmall) {
+    ExpectNth(generateRandomVector<int>(50000, 0, 10), 25000);
+    ExpectNth({5, 1, 4}, 1);
+    ExpectNth({7}, 0);
+}
+
+TEST_F(SelectTest, MedianOfMediansPath) {
+    //no partition budget, every step uses the worst case pivot
+    auto v = generateRandomVector<int>(20000, -1000, 1000);
+    auto sorted = v;
+    std::sort(sorted.begin(), sorted.end());
+    val::IntroSelect(v.data(), v.data() + 777, v.data() + v.size(), std::less<int>(), 0);
+    EXPECT_EQ(v[777], sorted[777]);
+}
+
+TEST_F(SelectTest, PartialSortBothPaths) {
+    auto v = generateRandomVector<int>(10000, -10000, 10000);
+    auto sorted = v;
+    std::sort(sorted.begin(), sorted.end());
+    for (size_t k : {size_t(10), size_t(5000), size_t(10000)})
+    {
+        auto p = v;
+        val::partial_sort(p.data(), p.data() + k, p.data() + p.size(), std::less<int>());
+        EXPECT_TRUE(std::equal(p.begin(), p.begin() + k, sorted.begin())) << "k " << k;
+    }
+}
+
+TEST_F(SelectTest, TopK) {
+    auto v = generateRandomVector<int>(10000, -10000, 10000);
+    auto original = v;
+    auto sorted = v;
+    std::sort(sorted.begin(), sorted.end(), std::greater<int>());
+
+    auto top = val::top_k(v.data(), v.data() + v.size(), 5, std::greater<int>());
+    EXPECT_EQ(top, std::vector<int>(sorted.begin(), sorted.begin() + 5));
+    auto many = val::top_k(v.data(), v.data() + v.size(), 3000, std::greater<int>());
+    EXPECT_EQ(many, std::vector<int>(sorted.begin(), sorted.begin() + 3000));
+    EXPECT_EQ(val::top_k(v.data(), v.data() + v.size(), 20000, std::greater<int>()), sorted);
+    EXPECT_EQ(v, original);
+}
+#pragma endregion SELECT_TESTS
+
+#pragma region SORT_BY_KEY_TESTS
+class SortByKeyTest : public ::testing::Test {};
+
+TEST_F(SortByKeyTest, KeyComputedOncePerElement) {
+    std::vector<std::string> v = {"Banana", "apple", "Cherry", "date", "APPLE", "banana"};
+    size_t calls = 0;
+    auto lower = [&calls](const std::string& s)
+    {
+        ++calls;
+        std::string key = s;
+        for (char& c : key) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        return key;
+    };
+    val::sort_by_key(v.begin(), v.end(), lower);
+    EXPECT_EQ(calls, v.size());
+    //stable: equal keys keep their order
+    EXPECT_EQ(v, (std::vector<std::string>{"apple", "APPLE", "Banana", "banana", "Cherry", "date"}));
+}
+
+TEST_F(SortByKeyTest, RadixIntegerKeys) {
+    struct Row
+    {
+        int64_t timestamp;
+        int id;
+    };
+    auto keys = generateRandomVector<int64_t>(100000, -1000000000000LL, 1000000000000LL);
+    std::vector<Row> rows;
+    for (int i = 0; i < static_cast<int>(keys.size()); ++i) rows.push_back({keys[i], i});
+    val::sort_by_key(rows.begin(), rows.end(), &Row::timestamp);
+    for (size_t i = 1; i < rows.size(); ++i)
+    {
+        ASSERT_LE(rows[i - 1].timestamp, rows[i].timestamp);
+        ASSERT_EQ(rows[i].timestamp, keys[rows[i].id]);
+    }
+}
+
+TEST_F(SortByKeyTest, RadixFloatKeys) {
+    auto v = generateRandomVector<double>(50000, -1000.0, 1000.0);
+    v.push_back(-0.0);
+    v.push_back(std::numeric_limits<double>::infinity());
+    v.push_back(-std::numeric_limits<double>::infinity());
+    val::sort_by_key(v.begin(), v.end(), [](double x) { return x; });
+    EXPECT_TRUE(std::is_sorted(v.begin(), v.end()));
+
+    //0.0 and -0.0 are equal keys, rows keyed by either keep their input order
+    std::vector<std::pair<double, int>> rows;
+    auto keys = generateRandomVector<int>(20000, -5, 5);
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        double key = keys[i] == 0 ? (i % 2 ? -0.0 : 0.0) : keys[i];
+        rows.push_back({key, static_cast<int>(i)});
+    }
+    auto expected = rows;
+    std::stable_sort(expected.begin(), expected.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    val::sort_by_key(rows.begin(), rows.end(), [](const auto& row) { return row.first; });
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        ASSERT_EQ(rows[i].second, expected[i].second);
+        ASSERT_EQ(std::signbit(rows[i].first), std::signbit(expected[i].first));
+    }
+}
+
+TEST_F(SortByKeyTest, CustomComparator) {
+    auto v = generateRandomVector<int>(10000, -100, 100);
+    val::sort_by_key(v.begin(), v.end(), [](int x) { return x * x; }, std::greater<>());
+    EXPECT_TRUE(std::is_sorted(v.begin(), v.end(), [](int a, int b) { return a * a > b * b; }));
+}
+#pragma endregion SORT_BY_KEY_TESTS
+
+#pragma region SORT_UNIQUE_TESTS
+class SortUniqueTest : public ::testing::Test {};
+
+TEST_F(SortUniqueTest, MatchesSortThenUnique) {
+    for (auto [size, range] : {std::pair{0, 10}, std::pair{1, 10}, std::pair{100, 5}, std::pair{100000, 1000},
+                               std::pair{100000, 1000000000}})
+    {
+        auto v = generateRandomVector<int>(size, 0, range);
+        auto expected = v;
+        std::sort(expected.begin(), expected.end());
+        expected.erase(std::unique(expected.begin(), expected.end()), expected.end());
+        val::sort_unique(v);
+        EXPECT_EQ(v, expected);
+    }
+
+    std::vector<double> same(50000, 2.5);
+    val::sort_unique(same);
+    EXPECT_EQ(same, std::vector<double>{2.5});
+}
+
+TEST_F(SortUniqueTest, StringsAndComparator) {
+    std::vector<std::string> v = {"pear", "fig", "apple", "fig", "kiwi", "pear", "apple", "date"};
+    auto end = val::sort_unique(v.begin(), v.end(), std::greater<>());
+    v.erase(end, v.end());
+    EXPECT_EQ(v, (std::vector<std::string>{"pear", "kiwi", "fig", "date", "apple"}));
+
+    std::deque<int> d = {3, 1, 3, 2, 1, 3};
+    d.erase(val::sort_unique(d.begin(), d.end()), d.end());
+    EXPECT_EQ(d, (std::deque<int>{1, 2, 3}));
+}
+
+TEST_F(SortUniqueTest, ReduceByKeySumsValues) {
+    struct Row
+    {
+        int key;
+        int64_t value;
+        int count;
+    };
+    auto keys = generateRandomVector<int>(200000, 0, 5000);
+    std::vector<Row> rows;
+    std::map<int, std::pair<int64_t, int>> expected;
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        rows.push_back({keys[i], static_cast<int64_t>(i), 1});
+        expected[keys[i]].first += i;
+        expected[keys[i]].second++;
+    }
+
+    val::sort_reduce_by_key(rows, &Row::key, [](Row& into, Row&& row)
+    {
+        into.value += row.value;
+        into.count += row.count;
+    });
+    ASSERT_EQ(rows.size(), expected.size());
+    size_t i = 0;
+    for (const auto& [key, sum] : expected)
+    {
+        EXPECT_EQ(rows[i].key, key);
+        EXPECT_EQ(rows[i].value, sum.first);
+        EXPECT_EQ(rows[i].count, sum.second);
+        ++i;
+    }
+}
+
+TEST_F(SortUniqueTest, ReduceMovesElements) {
+    std::vector<std::pair<std::string, std::vector<int>>> groups;
+    for (int i = 0; i < 1000; ++i) groups.push_back({"group" + std::to_string(i % 7), {i}});
+    val::sort_reduce_by_key(groups, [](const auto& g) { return g.first; }, [](auto& into, auto&& g)
+    {
+        into.second.insert(into.second.end(), g.second.begin(), g.second.end());
+    });
+    ASSERT_EQ(groups.size(), 7u);
+    for (size_t k = 0; k < groups.size(); ++k)
+    {
+        EXPECT_EQ(groups[k].first, "group" + std::to_string(k));
+        auto members = groups[k].second;
+        std::sort(members.begin(), members.end());
+        ASSERT_EQ(members.size(), k < 1000 % 7 ? 143u : 142u);
+        for (int m : members) EXPECT_EQ(m % 7, static_cast<int>(k));
+    }
+}
+#pragma endregion SORT_UNIQUE_TESTS
+
+#pragma region ARGSORT_TESTS
+class ArgsortTest : public ::testing::Test {};
+
+TEST_F(ArgsortTest, PermutationSortsRange) {
+    auto v = generateRandomVector<int>(50000, -1000, 1000);
+    auto original = v;
+    auto perm = val::argsort<uint32_t>(v.begin(), v.end());
+    EXPECT_EQ(v, original);
+    for (size_t i = 1; i < perm.size(); ++i) ASSERT_LE(v[perm[i - 1]], v[perm[i]]);
+
+    val::apply_permutation(v.begin(), v.end(), std::move(perm));
+    auto expected = original;
+    std::sort(expected.begin(), expected.end());
+    EXPECT_EQ(v, expected);
+}
+
+TEST_F(ArgsortTest, WideRowsWithComparator) {
+    struct Row
+    {
+        int key;
+        std::array<char, 512> payload;
+    };
+    auto keys = generateRandomVector<int>(2000, 0, 100000);
+    std::vector<Row> rows(keys.size());
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        rows[i].key = keys[i];
+        rows[i].payload.fill(static_cast<char>(keys[i] % 128));
+    }
+    auto perm = val::argsort(rows.begin(), rows.end(), [](const Row& a, const Row& b) { return a.key > b.key; });
+    val::apply_permutation(rows.begin(), rows.end(), perm);
+    for (size_t i = 0; i < rows.size(); ++i)
+    {
+        if (i > 0)
+        {
+            ASSERT_GE(rows[i - 1].key, rows[i].key);
+        }
+        ASSERT_EQ(rows[i].payload[511], static_cast<char>(rows[i].key % 128));
+    }
+}
+
+TEST_F(ArgsortTest, NonMovableElements) {
+    struct Pinned
+    {
+        explicit Pinned(int v) : value(v) {}
+        Pinned(const Pinned&) = delete;
+        Pinned& operator=(const Pinned&) = delete;
+        int value;
+    };
+    std::deque<Pinned> items;
+    for (int v : {5, 3, 9, 1, 7}) items.emplace_back(v);
+    auto perm = val::argsort(items.begin(), items.end(), [](const Pinned& a, const Pinned& b) { return a.value < b.value; });
+    std::vector<int> order;
+    for (size_t i : perm) order.push_back(items[i].value);
+    EXPECT_EQ(order, (std::vector<int>{1, 3, 5, 7, 9}));
+}
+
+TEST_F(ArgsortTest, InvalidArguments) {
+    std::vector<int> v(300, 1);
+    EXPECT_THROW(val::argsort<uint8_t>(v.begin(), v.end()), std::length_error);
+    EXPECT_THROW(val::apply_permutation(v.begin(), v.end(), std::vector<size_t>{0, 1}), std::invalid_argument);
+
+    std::vector<int> two = {7, 8};
+    EXPECT_THROW(val::apply_permutation(two.begin(), two.end(), std::vector<size_t>{1, 1}), std::invalid_argument);
+    EXPECT_THROW(val::apply_permutation(two.begin(), two.end(), std::vector<size_t>{0, 2}), std::invalid_argument);
+    EXPECT_THROW(val::apply_permutation(two.begin(), two.end(), std::vector<int>{-1, 0}), std::invalid_argument);
+    EXPECT_EQ(two, (std::vector<int>{7, 8}));
+}
+#pragma endregion ARGSORT_TESTS
+
+#pragma region NETWORK_SORT_TESTS
+class NetworkSortTest : public ::testing::Test
+{
+protected:
+    //a network sorts everything iff it sorts every 0/1 input
+    template <size_t N>
+    static void ExpectSortsAllBinaryInputs()
+    {
+        for (uint64_t bits = 0; bits < (uint64_t(1) << N); ++bits)
+        {
+            std::array<int, N> a;
+            for (size_t i = 0; i < N; ++i) a[i] = (bits >> i) & 1;
+            val::sort<N>(a.data());
+            ASSERT_TRUE(std::is_sorted(a.begin(), a.end())) << "N = " << N << ", input " << bits;
+        }
+    }
+};
+
+TEST_F(NetworkSortTest, ZeroOnePrinciple) {
+    ExpectSortsAllBinaryInputs<2>();
+    ExpectSortsAllBinaryInputs<3>();
+    ExpectSortsAllBinaryInputs<5>();
+    ExpectSortsAllBinaryInputs<8>();
+    ExpectSortsAllBinaryInputs<11>();
+    ExpectSortsAllBinaryInputs<16>();
+    ExpectSortsAllBinaryInputs<19>();
+}
+
+TEST_F(NetworkSortTest, RandomArrays) {
+    for (int round = 0; round < 200; ++round)
+    {
+        auto v = generateRandomVector<int64_t>(32, -50, 50);
+        std::array<int64_t, 32> a;
+        std::copy(v.begin(), v.end(), a.begin());
+        val::sort(a);
+        std::sort(v.begin(), v.end());
+        ASSERT_TRUE(std::equal(a.begin(), a.end(), v.begin()));
+
+        auto d = generateRandomVector<double>(27, -1.0, 1.0);
+        val::sort<27>(d.data(), std::greater<>());
+        ASSERT_TRUE(std::is_sorted(d.begin(), d.end(), std::greater<>()));
+    }
+}
+
+TEST_F(NetworkSortTest, NonTrivialTypes) {
+    std::array<std::string, 7> a = {"pear", "apple", "fig", "kiwi", "banana", "date", "cherry"};
+    val::sort(a);
+    EXPECT_EQ(a, (std::array<std::string, 7>{"apple", "banana", "cherry", "date", "fig", "kiwi", "pear"}));
+}
+
+TEST_F(NetworkSortTest, Constexpr) {
+    constexpr auto sorted = []
+    {
+        std::array<int, 10> a = {9, 3, 7, 1, 8, 2, 6, 0, 5, 4};
+        val::sort(a);
+        return a;
+    }();
+    static_assert(sorted == std::array<int, 10>{0, 1, 2, 3, 4, 5, 6, 7, 8, 9});
+    static_assert(val::network::NETWORK<16>.size() == 63);
+    EXPECT_TRUE(std::is_sorted(sorted.begin(), sorted.end()));
+}
+#pragma endregion NETWORK_SORT_TESTS
+
+#pragma region SORT_MANY_TESTS
+class SortManyTest : public ::testing::Test
+{
+protected:
+    //sizes like per-user lists: mostly tiny, some up to a few hundred
+    static std::vector<std::vector<int>> MakeLists(size_t count)
+    {
+        std::mt19937 gen(11);
+        std::vector<std::vector<int>> lists(count);
+        for (auto& list : lists)
+        {
+            size_t size = gen() % 4 == 0 ? gen() % 500 : gen() % 40;
+            list.resize(size);
+            for (auto& x : list) x = static_cast<int>(gen() % 1000);
+        }
+        return lists;
+    }
+};
+
+TEST_F(SortManyTest, SpansOfEverySize) {
+    for (unsigned threads : {1u, 4u})
+    {
+        auto lists = MakeLists(20000);
+        auto expected = lists;
+        for (auto& l : expected) std::sort(l.begin(), l.end());
+
+        std::vector<std::span<int>> spans(lists.begin(), lists.end());
+        val::sort_many(spans, std::less<int>(), threads);
+        EXPECT_EQ(lists, expected);
+    }
+}
+
+TEST_F(SortManyTest, VectorsWithComparator) {
+    std::vector<std::vector<std::string>> lists(300);
+    std::mt19937 gen(5);
+    for (size_t i = 0; i < lists.size(); ++i)
+        for (size_t j = 0; j < i % 70; ++j) lists[i].push_back(std::to_string(gen() % 10000));
+    auto expected = lists;
+    for (auto& l : expected) std::sort(l.begin(), l.end(), std::greater<>());
+
+    val::sort_many(lists, std::greater<>());
+    EXPECT_EQ(lists, expected);
+}
+
+TEST_F(SortManyTest, LargeArraysAmongTinyOnes) {
+    //the large arrays get chunks of their own, the tiny ones around them are still sorted once each
+    auto lists = MakeLists(5000);
+    for (size_t i : {0u, 1777u, 4999u}) lists[i] = generateRandomVector<int>(3 * val::BATCH_SORT_CHUNK, 0, 1000);
+    auto expected = lists;
+    for (auto& l : expected) std::sort(l.begin(), l.end());
+
+    std::vector<std::span<int>> spans(lists.begin(), lists.end());
+    val::sort_many(spans, std::less<int>(), 4);
+    EXPECT_EQ(lists, expected);
+}
+#pragma endregion SORT_MANY_TESTS
+
+#pragma region STRING_SORT_TESTS
+class StringSortTest : public ::testing::Test
+{
+protected:
+    //log-like keys: long shared prefixes that only differ near the end
+    static std::vector<std::string> MakeLogKeys(size_t count)
+    {
+        std::mt19937 gen(7);
+        std::uniform_int_distribution<> host(0, 50), seq(0, 100000);
+        std::vector<std::string> keys;
+        for (size_t i = 0; i < count; ++i)
+            keys.push_back("2024-05-17T12:00:00 host-" + std::to_string(host(gen)) + " request " +
+                           std::to_string(seq(gen)));
+        return keys;
+    }
+};
+
+TEST_F(StringSortTest, SharedPrefixes) {
+    auto v = MakeLogKeys(50000);
+    auto expected = v;
+    std::sort(expected.begin(), expected.end());
+    val::sort(v.data(), v.data() + v.size(), std::less<std::string>());
+    EXPECT_EQ(v, expected);
+}
+
+TEST_F(StringSortTest, EmbeddedZerosAndEmpty) {
+    using namespace std::string_literals;
+    std::vector<std::string> v = {"ab"s, "ab\0"s, ""s, "ab\0\0"s, "a"s, "abcdefghij"s, "abcdefgh"s, "abcdefgh\0"s,
+                                  "\xff"s, "abcdefghi"s, ""s, "b"s};
+    for (int i = 0; i < 5; ++i) v.insert(v.end(), v.begin(), v.begin() + 12);
+    auto expected = v;
+    std::sort(expected.begin(), expected.end());
+    val::sort(v.data(), v.data() + v.size(), std::less<>());
+    EXPECT_EQ(v, expected);
+}
+
+TEST_F(StringSortTest, StringViews) {
+    auto keys = MakeLogKeys(5000);
+    std::vector<std::string_view> v(keys.begin(), keys.end());
+    auto expected = v;
+    std::sort(expected.begin(), expected.end());
+    val::sort(v);
+    EXPECT_EQ(v, expected);
+}
+
+TEST_F(StringSortTest, Duplicates) {
+    std::vector<std::string> v;
+    for (int i = 0; i < 20000; ++i) v.push_back("same-prefix-key-" + std::to_string(i % 10));
+    val::sort(v.data(), v.data() + v.size(), std::less<std::string>());
+    EXPECT_TRUE(std::is_sorted(v.begin(), v.end()));
+}
+
+TEST_F(StringSortTest, SkewedPrefixes) {
+    //organ pipe of big endian counters: every chunk differs, pivots land near the ends of the range
+    std::vector<std::string> v;
+    for (uint64_t i = 0; i < 100000; ++i)
+    {
+        uint64_t key = i < 50000 ? i : 100000 - i;
+        std::string s(8, '\0');
+        for (int k = 0; k < 8; ++k) s[k] = static_cast<char>(key >> (56 - 8 * k));
+        v.push_back(s + "-" + std::to_string(i % 3));
+    }
+    auto expected = v;
+    std::sort(expected.begin(), expected.end());
+    val::sort(v.data(), v.data() + v.size(), std::less<std::string>());
+    EXPECT_EQ(v, expected);
+}
+
+TEST_F(StringSortTest, BudgetFallsBackToHeapSort) {
+    auto keys = MakeLogKeys(5000);
+    std::vector<val::strsort::Entry> entries;
+    for (size_t i = 0; i < keys.size(); ++i)
+        entries.push_back({val::strsort::LoadPrefix(keys[i].data(), keys[i].size(), 0), keys[i].data(), keys[i].size(), i});
+    //one partition, then everything left is heap sorted
+    val::strsort::MultikeyQuickSort(entries.data(), entries.data() + entries.size(), 0, 1);
+    for (size_t i = 1; i < entries.size(); ++i)
+        ASSERT_LE(keys[entries[i - 1].index], keys[entries[i].index]);
+}
+#pragma endregion STRING_SORT_TESTS
+
+#pragma region ASYNC_TESTS
+class SortAsyncTest : public ::testing::Test
+{
+protected:
+    //runs the task right away on the calling thread
+    struct InlineExecutor
+    {
+        void operator()(std::function<void()> task) const { task(); }
+    };
+};
+
+TEST_F(SortAsyncTest, CompletesOnAnotherThread) {
+    auto v = generateRandomVector<int>(500000, -1000000, 1000000);
+    auto expected = v;
+    std::sort(expected.begin(), expected.end());
+    auto future = val::sort_async(v.begin(), v.end(), std::less<int>());
+    EXPECT_EQ(future.get(), val::SortStatus::Completed);
+    EXPECT_EQ(v, expected);
+}
+
+TEST_F(SortAsyncTest, ProgressReachesTotal) {
+    auto v = generateRandomVector<int>(200000, 0, 1000);
+    std::vector<size_t> reports;
+    auto future = val::sort_async(v.data(), v.data() + v.size(), std::less<int>(), InlineExecutor{}, {},
+                                  [&](size_t sorted, size_t total)
+                                  {
+                                      EXPECT_EQ(total, 200000u);
+                                      reports.push_back(sorted);
+                                  });
+    EXPECT_EQ(future.get(), val::SortStatus::Completed);
+    EXPECT_TRUE(std::is_sorted(v.begin(), v.end()));
+    ASSERT_FALSE(reports.empty());
+    EXPECT_TRUE(std::is_sorted(reports.begin(), reports.end()));
+    EXPECT_EQ(reports.back(), 200000u);
+    EXPECT_LE(reports.size(), 101u);
+}
+
+TEST_F(SortAsyncTest, CancelledMidway) {
+    auto v = generateRandomVector<int>(300000, -1000000, 1000000);
+    auto original = v;
+    std::stop_source source;
+    auto future = val::sort_async(v.begin(), v.end(), std::less<int>(), InlineExecutor{}, source.get_token(),
+                                  [&](size_t sorted, size_t total)
+                                  {
+                                      if (sorted * 5 >= total) source.request_stop();
+                                  });
+    EXPECT_EQ(future.get(), val::SortStatus::Cancelled);
+    //nothing is lost, the elements are only rearranged
+    std::sort(v.begin(), v.end());
+    std::sort(original.begin(), original.end());
+    EXPECT_EQ(v, original);
+}
+
+TEST_F(SortAsyncTest, StoppedBeforeStartAndStrings) {
+    std::vector<std::string> v = {"c", "a", "b"};
+    std::stop_source source;
+    source.request_stop();
+    EXPECT_EQ(val::sort_async(v.begin(), v.end(), std::less<>(), InlineExecutor{}, source.get_token()).get(),
+              val::SortStatus::Cancelled);
+    EXPECT_EQ(v, (std::vector<std::string>{"c", "a", "b"}));
+
+    EXPECT_EQ(val::sort_async(v.begin(), v.end(), std::less<>()).get(), val::SortStatus::Completed);
+    EXPECT_EQ(v, (std::vector<std::string>{"a", "b", "c"}));
+}
+
+TEST_F(SortAsyncTest, ComparatorExceptionReachesFuture) {
+    auto v = generateRandomVector<int>(10000, 0, 100);
+    auto throwing = [](int a, int b)
+    {
+        if (a == 50 || b == 50) throw std::runtime_error("bad key");
+        return a < b;
+    };
+    auto future = val::sort_async(v.begin(), v.end(), throwing);
+    EXPECT_THROW(future.get(), std::runtime_error);
+}
+#pragma endregion ASYNC_TESTS
+
+#pragma region INSTRUMENTATION_TESTS
+class SortInstrumentationTest : public ::testing::Test {};
+
+TEST_F(SortInstrumentationTest, CountsMatchComparator) {
+    auto v = generateRandomVector<int>(100000, -100000, 100000);
+    auto plain = v;
+    size_t calls = 0;
+    auto counting = [&calls](int a, int b) { calls++; return a < b; };
+
+    val::SortCounters counters;
+    val::sort(v.data(), v.data() + v.size(), counting, counters);
+    EXPECT_TRUE(std::is_sorted(v.begin(), v.end()));
+    EXPECT_EQ(counters.comparisons, calls);
+    EXPECT_GT(counters.swaps, 0u);
+    EXPECT_GT(counters.moves, 0u);
+    EXPECT_GT(counters.partitions, 0u);
+    EXPECT_EQ(counters.depth, 0u);
+    //the smaller side is recursed into, so depth stays logarithmic
+    EXPECT_LE(counters.maxDepth, 2 * 17u);
+    EXPECT_GE(counters.meanImbalance(), 0.5);
+    EXPECT_LE(counters.worstImbalance, 1.0);
+
+    val::sort(plain.data(), plain.data() + plain.size(), std::less<int>());
+    EXPECT_EQ(plain, v);
+}
+
+TEST_F(SortInstrumentationTest, EnginesShareCounters) {
+    auto v = generateRandomVector<int>(5000, 0, 1000);
+    auto h = v, q = v;
+    val::SortCounters lomuto, hoare, quick;
+    val::HybridSortNoTailRecursion<val::PartitionScheme::Lomuto>(v.data(), v.data() + v.size(), std::less<int>(), 16, lomuto);
+    val::HybridSort(h.data(), h.data() + h.size(), std::less<int>(), hoare);
+    val::QuickSort(q.data(), q.data() + q.size(), std::less<int>(), quick);
+    for (auto* r : {&v, &h, &q}) EXPECT_TRUE(std::is_sorted(r->begin(), r->end()));
+    for (auto* c : {&lomuto, &hoare, &quick})
+    {
+        EXPECT_GT(c->swaps, 0u);
+        EXPECT_GT(c->partitions, 0u);
+        EXPECT_GT(c->maxDepth, 1u);
+        EXPECT_EQ(c->depth, 0u);
+    }
+}
+
+TEST_F(SortInstrumentationTest, InsertionSortMoves) {
+    std::vector<int> v = {5, 4, 3, 2, 1};
+    val::SortCounters counters;
+    val::InsertionSort(v.data(), v.data() + v.size(), std::less<int>(), counters);
+    EXPECT_EQ(v, (std::vector<int>{1, 2, 3, 4, 5}));
+    //element i shifts i others and is moved out and back in
+    EXPECT_EQ(counters.moves, 3u + 4u + 5u + 6u);
+}
+#pragma endregion INSTRUMENTATION_TESTS
+
 #pragma region PERF_TESTS
 class SortPerformanceTest : public ::testing::Test {
 protected:
+    //every engine gets warmups and repetitions on a fresh copy of v, reported as median and percentiles
+    //with the hardware counters perf_event_open could read here
     void BenchmarkSort(const std::string& test_name, std::vector<int>& v) {
-        auto v_copy = v;  // Keep original for std::sort comparison
-
-        // Time custom sort
-        auto start = std::chrono::high_resolution_clock::now();
-        val::sort(v.data(), v.data() + v.size(), std::less<int>());
-        auto end = std::chrono::high_resolution_clock::now();
-        auto custom_duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+        val::bench::BenchmarkOptions options{1, 7};
+        std::vector<int> work;
+        auto measure = [&](auto sortFn) {
+            auto result = val::bench::Measure([&] { work = v; }, [&] { sortFn(work.data(), work.data() + work.size()); },
+                                              options);
+            EXPECT_TRUE(std::is_sorted(work.begin(), work.end()));
+            return result;
+        };
 
-        EXPECT_TRUE(std::is_sorted(v.begin(), v.end()));
-
-        // Time std::sort for comparison
-        start = std::chrono::high_resolution_clock::now();
-        std::sort(v_copy.begin(), v_copy.end());
-        end = std::chrono::high_resolution_clock::now();
-        auto std_duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+        auto custom = measure([](int* first, int* last) { val::sort(first, last, std::less<int>()); });
+        auto standard = measure([](int* first, int* last) { std::sort(first, last); });
+        auto stable = measure([](int* first, int* last) { val::stable_sort(first, last, std::less<int>()); });
+        auto sample = measure([](int* first, int* last) { val::sample_sort(first, last, std::less<int>()); });
 
         std::cout << "\n" << test_name << ":\n";
-        std::cout << "  Custom sort: " << custom_duration.count() << " μs\n";
-        std::cout << "  std::sort:   " << std_duration.count() << " μs\n";
-        std::cout << "  Ratio:       " << (double)custom_duration.count() / std_duration.count() << "x\n";
+        val::bench::PrintResult(std::cout, "Custom sort", custom);
+        val::bench::PrintResult(std::cout, "std::sort  ", standard);
+        std::cout << "  Ratio:       " << custom.median() / standard.median() << "x\n";
+        val::bench::PrintResult(std::cout, "Stable sort", stable);
+        val::bench::PrintResult(std::cout, "Sample sort", sample);
+
+        //counters come from a separate instrumented run so they don't distort the timing above
+        val::SortCounters counters;
+        val::sort(v.data(), v.data() + v.size(), std::less<int>(), counters);
+        EXPECT_TRUE(std::is_sorted(v.begin(), v.end()));
+        std::cout << "  Comparisons: " << counters.comparisons << ", swaps: " << counters.swaps
+                  << ", moves: " << counters.moves << "\n";
+        std::cout << "  Partitions:  " << counters.partitions << ", imbalance mean " << counters.meanImbalance()
+                  << " worst " << counters.worstImbalance << ", max depth " << counters.maxDepth << "\n";
     }
 };
 
@@ -419,83 +1612,11 @@ TEST_F(SortPerformanceTest, Benchmark_NearlySorted_100K) {
 
 #pragma region PERF_CSV_TESTS
 
-// TEST(SortPerformance, InsertionSortTiming) {
-//     std::ofstream csv("insertion_sort_times.csv");
-//     csv << "Size,Time_ms\n";
-//
-//     std::random_device rd;
-//     std::mt19937 gen(rd());
-//
-//     constexpr int TIMES = 10;
-//     constexpr int MIN_SIZE = 50;
-//     constexpr int MAX_SIZE = 4000;
-//
-//     for (int size = MIN_SIZE; size <= MAX_SIZE; size+=20) {
-//
-//         double time_total = 0;
-//
-//         for (int i = 0; i < TIMES; ++i)
-//         {
-//             std::vector<int> data(size);
-//             std::uniform_int_distribution<> dis(1, 100000);
-//
-//             for (int& val : data) {
-//                 val = dis(gen);
-//             }
-//             auto start = std::chrono::high_resolution_clock::now();
-//             val::InsertionSort(data.data(), data.data() + data.size(), std::less<>());
-//             auto end = std::chrono::high_resolution_clock::now();
-//
-//             auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-//             time_total = duration.count() / 1000.0;
-//         }
-//
-//         csv << size << "," << time_total/TIMES << "\n";
-//         //std::cout << "InsertionSort - Size: " << size << ", Time: " << time_total/TIMES << " ms\n";
-//     }
-//
-//     csv.close();
-//     SUCCEED();
-// }
-//
-// TEST(SortPerformance, QuickSortTiming) {
-//     std::ofstream csv("quick_sort_times.csv");
-//     csv << "Size,Time_ms\n";
-//
-//     std::random_device rd;
-//     std::mt19937 gen(rd());
-//     constexpr int TIMES = 5;
-//     constexpr int MIN_SIZE = 50;
-//     constexpr int MAX_SIZE = 4000;
-//
-//     for (int size = MIN_SIZE; size <= MAX_SIZE; size+=20) {
-//         double total_time = 0;
-//         for (int i = 0 ;i < TIMES; ++i)
-//         {
-//             std::vector<int> data(size);
-//             std::uniform_int_distribution<> dis(1, 100000);
-//
-//             for (int& val : data) {
-//                 val = dis(gen);
-//             }
-//             auto start = std::chrono::high_resolution_clock::now();
-//             val::QuickSort(data.data(), data.data() + data.size(), std::less<>());
-//             auto end = std::chrono::high_resolution_clock::now();
-//
-//             auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-//             total_time+= duration.count() / 1000.0;
-//         }
-//         csv << size << "," << total_time/TIMES << "\n";
-//         //std::cout << "QuickSort - Size: " << size << ", Time: " << total_time/TIMES << " ms\n";
-//     }
-//
-//     csv.close();
-//     SUCCEED();
-// }
+//the size / time csv files in stats/ used to come from timing tests here,
+//the sort_bench target now covers every engine over sizes, key types and input distributions
 
 #pragma endregion
 
-#include "../2-array/valarray.hpp"
 int main(int argc, char **argv)
 {
 
@@ -521,7 +1642,7 @@ int main(int argc, char **argv)
     std::cout << std::endl;
 
     //1 2 2 3 3 4 4 5 9
-    val::sort(arr.beginPtr(), arr.endPtr(), std::less<int>());
+    val::sort(arr, std::less<int>());
 
     std::cout << "Sorted custom Array: ";
     for (auto val : arr)
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace val
+{
+    //tournament tree of losers over k sorted sources
+    //every source is represented only by a pointer to its current element (nullptr once it runs out),
+    //so it works the same for memory ranges and buffered file readers.
+    //ties go to the lower source index, which keeps the merge stable
+    template <typename T, typename Compare>
+    class LoserTree
+    {
+    public:
+        LoserTree(size_t k, Compare comp)
+            : m_k(k)
+            , m_comp(comp)
+            , m_keys(k, nullptr)
+            , m_tree(std::max<size_t>(k, 1), 0)
+        {
+        }
+
+        //heads[i] is the first element of source i or nullptr if it's empty
+        void init(const std::vector<const T*>& heads)
+        {
+            m_keys = heads;
+            if (m_k == 0) return;
+            std::vector<size_t> winners(2 * m_k);
+            for (size_t i = 0; i < m_k; i++) winners[m_k + i] = i;
+            for (size_t node = m_k - 1; node > 0; node--)
+            {
+                size_t a = winners[2 * node];
+                size_t b = winners[2 * node + 1];
+                if (less(b, a)) std::swap(a, b);
+                winners[node] = a;
+                m_tree[node] = b;
+            }
+            m_tree[0] = m_k == 1 ? 0 : winners[1];
+        }
+
+        //index of the source holding the smallest element, check empty() first
+        size_t winner() const { return m_tree[0]; }
+        const T& top() const { return *m_keys[m_tree[0]]; }
+        bool empty() const { return m_k == 0 || m_keys[m_tree[0]] == nullptr; }
+
+        //the winner moved to its next element (nullptr if it ran out)
+        void replaceTop(const T* next)
+        {
+            size_t winner = m_tree[0];
+            m_keys[winner] = next;
+            for (size_t node = (winner + m_k) / 2; node > 0; node /= 2)
+            {
+                if (less(m_tree[node], winner)) std::swap(m_tree[node], winner);
+            }
+            m_tree[0] = winner;
+        }
+
+    private:
+        bool less(size_t a, size_t b) const
+        {
+            if (!m_keys[a]) return false;
+            if (!m_keys[b]) return true;
+            if (m_comp(*m_keys[a], *m_keys[b])) return true;
+            if (m_comp(*m_keys[b], *m_keys[a])) return false;
+            return a < b;
+        }
+
+        size_t m_k;
+        Compare m_comp;
+        std::vector<const T*> m_keys;
+        //m_tree[0] is the overall winner, m_tree[1..k) losers of internal nodes, leaf i is node k + i
+        std::vector<size_t> m_tree;
+    };
+
+    template <typename T>
+    struct SortedSequence
+    {
+        T* first;
+        T* last;
+    };
+
+    //stable k-way merge that moves the sequences to out, returns the end of the output
+    template <typename T, typename Compare>
+    T* MultiwayMerge(const std::vector<SortedSequence<T>>& seqs, T* out, Compare comp)
+    {
+        std::vector<T*> cur;
+        std::vector<const T*> heads;
+        for (const auto& s : seqs)
+        {
+            cur.push_back(s.first);
+            heads.push_back(s.first != s.last ? s.first : nullptr);
+        }
+        LoserTree<T, Compare> tree(seqs.size(), comp);
+        tree.init(heads);
+        while (!tree.empty())
+        {
+            size_t i = tree.winner();
+            *out++ = std::move(*cur[i]);
+            ++cur[i];
+            tree.replaceTop(cur[i] != seqs[i].last ? cur[i] : nullptr);
+        }
+        return out;
+    }
+
+    //for every sequence returns how many of its elements go before position rank of the stable merged output
+    //(equal elements order by sequence index), O(k^2 log^2 n)
+    template <typename T, typename Compare>
+    std::vector<size_t> MultiwaySplit(const std::vector<SortedSequence<T>>& seqs, size_t rank, Compare comp)
+    {
+        size_t k = seqs.size();
+        //position of element j of sequence i in the merged output
+        auto mergedRank = [&](size_t i, size_t j)
+        {
+            const T& x = seqs[i].first[j];
+            size_t r = j;
+            for (size_t m = 0; m < k; m++)
+            {
+                if (m < i) r += std::upper_bound(seqs[m].first, seqs[m].last, x, comp) - seqs[m].first;
+                else if (m > i) r += std::lower_bound(seqs[m].first, seqs[m].last, x, comp) - seqs[m].first;
+            }
+            return r;
+        };
+
+        std::vector<size_t> splits(k);
+        for (size_t i = 0; i < k; i++)
+        {
+            size_t lo = 0;
+            size_t hi = seqs[i].last - seqs[i].first;
+            while (lo < hi)
+            {
+                size_t mid = lo + (hi - lo) / 2;
+                if (mergedRank(i, mid) < rank) lo = mid + 1;
+                else hi = mid;
+            }
+            splits[i] = lo;
+        }
+        return splits;
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+namespace val
+{
+    //largest N with a compile time network
+    inline constexpr size_t NETWORK_SORT_MAX = 32;
+
+    namespace network
+    {
+        struct Comparator
+        {
+            uint8_t i;
+            uint8_t j;
+        };
+
+        //Batcher's odd-even merge sort for any n (the power of 2 network with comparators past n dropped),
+        //calls emit(i, j) with i < j. within a few comparators of the best known networks up to 32
+        template <typename Emit>
+        constexpr void Batcher(size_t n, Emit emit)
+        {
+            for (size_t p = 1; p < n; p *= 2)
+                for (size_t k = p; k >= 1; k /= 2)
+                    for (size_t j = k % p; j + k < n; j += 2 * k)
+                        for (size_t i = 0; i < k && i + j + k < n; i++)
+                            if ((i + j) / (2 * p) == (i + j + k) / (2 * p)) emit(i + j, i + j + k);
+        }
+
+        constexpr size_t ComparatorCount(size_t n)
+        {
+            size_t count = 0;
+            Batcher(n, [&](size_t, size_t) { count++; });
+            return count;
+        }
+
+        template <size_t N>
+        constexpr auto MakeNetwork()
+        {
+            std::array<Comparator, ComparatorCount(N)> network{};
+            size_t c = 0;
+            Batcher(N, [&](size_t i, size_t j) { network[c++] = {static_cast<uint8_t>(i), static_cast<uint8_t>(j)}; });
+            return network;
+        }
+
+        template <size_t N>
+        inline constexpr auto NETWORK = MakeNetwork<N>();
+
+        //cheap to copy types are selected without a branch (cmov / min / max), the rest is swapped
+        template <typename T, typename Compare>
+        constexpr void CompareExchange(T& a, T& b, Compare& comp)
+        {
+            if constexpr (std::is_trivially_copyable_v<T> && sizeof(T) <= 16)
+            {
+                bool greater = comp(b, a);
+                T lo = greater ? b : a;
+                T hi = greater ? a : b;
+                a = lo;
+                b = hi;
+            }
+            else
+            {
+                if (comp(b, a)) std::swap(a, b);
+            }
+        }
+    } //namespace network
+
+    //sorts data[0, N) with a sorting network fixed at compile time, no loops or bounds at runtime
+    //usable in constant expressions. not stable
+    template <size_t N, typename T, typename Compare = std::ranges::less>
+    constexpr void sort(T* data, Compare comp = {})
+    {
+        static_assert(N <= NETWORK_SORT_MAX, "sorting networks are generated up to NETWORK_SORT_MAX elements");
+        for (const auto& c : network::NETWORK<N>)
+            network::CompareExchange(data[c.i], data[c.j], comp);
+    }
+
+    template <typename T, size_t N, typename Compare = std::ranges::less>
+        requires (N <= NETWORK_SORT_MAX)
+    constexpr void sort(std::array<T, N>& data, Compare comp = {})
+    {
+        sort<N>(data.data(), comp);
+    }
+}
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <exception>
+#include <random>
+#include <thread>
+#include <vector>
+#include "multiway_merge.hpp"
+#include "sort.hpp"
+#include "stable_sort.hpp"
+
+namespace val
+{
+    //below this many elements per thread the threads cost more than they save
+    inline constexpr size_t PARALLEL_MIN_CHUNK = 1 << 14;
+
+    inline unsigned DefaultThreadCount()
+    {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    //runs fn(0) .. fn(threads - 1) concurrently, the calling thread takes index 0
+    //the first exception thrown by any of them is rethrown after all are joined
+    template <typename Fn>
+    void ParallelFor(unsigned threads, Fn fn)
+    {
+        std::vector<std::exception_ptr> errors(threads);
+        auto guarded = [&](unsigned t)
+        {
+            try
+            {
+                fn(t);
+            }
+            catch (...)
+            {
+                errors[t] = std::current_exception();
+            }
+        };
+
+        std::vector<std::thread> workers;
+        workers.reserve(threads);
+        for (unsigned t = 1; t < threads; t++) workers.emplace_back(guarded, t);
+        guarded(0);
+        for (auto& w : workers) w.join();
+
+        for (auto& e : errors)
+            if (e) std::rethrow_exception(e);
+    }
+
+    //stable parallel multiway merge sort:
+    //every thread stable sorts its chunk, then the merged output is split into equal disjoint ranges
+    //and every thread fills its range with a k-way merge from the sorted chunks
+    template <typename T, typename Compare>
+    void parallel_stable_sort(T* first, T* last, Compare comp, unsigned threads = 0)
+    {
+        size_t len = last - first;
+        if (threads == 0) threads = DefaultThreadCount();
+        threads = static_cast<unsigned>(std::min<size_t>(threads, len / PARALLEL_MIN_CHUNK));
+        if (threads <= 1)
+        {
+            stable_sort(first, last, comp);
+            return;
+        }
+
+        auto boundary = [&](size_t t) { return len * t / threads; };
+
+        ParallelFor(threads, [&](unsigned t)
+        {
+            stable_sort(first + boundary(t), first + boundary(t + 1), comp);
+        });
+
+        //chunks are merged from a copy back into the original range
+        std::vector<T> buffer(std::make_move_iterator(first), std::make_move_iterator(last));
+        std::vector<SortedSequence<T>> chunks;
+        for (unsigned t = 0; t < threads; t++)
+            chunks.push_back({buffer.data() + boundary(t), buffer.data() + boundary(t + 1)});
+
+        ParallelFor(threads, [&](unsigned t)
+        {
+            std::vector<size_t> from = MultiwaySplit(chunks, boundary(t), comp);
+            std::vector<size_t> to = MultiwaySplit(chunks, boundary(t + 1), comp);
+            std::vector<SortedSequence<T>> parts;
+            for (unsigned i = 0; i < threads; i++)
+                parts.push_back({chunks[i].first + from[i], chunks[i].first + to[i]});
+            MultiwayMerge(parts, first + boundary(t), comp);
+        });
+    }
+
+    //samples taken per splitter
+    inline constexpr size_t SAMPLE_OVERSAMPLING = 16;
+    inline constexpr size_t SAMPLE_SORT_MAX_BUCKETS = 256;
+
+    //sorted distinct splitters laid out as an implicit binary search tree (root 1, children 2i and 2i + 1).
+    //classify takes log2(leaves) steps without data dependent branches and also checks equality with the
+    //splitter, so every splitter gets its own bucket and heavy keys never have to be sorted
+    template <typename T, typename Compare>
+    class SplitterTree
+    {
+    public:
+        SplitterTree(std::vector<T> splitters, Compare comp)
+            : m_comp(comp)
+            , m_splitters(std::move(splitters))
+        {
+            m_count = m_splitters.size();
+            m_leaves = std::bit_ceil(m_count + 1);
+            m_levels = std::countr_zero(m_leaves);
+
+            //pad with copies of the largest splitter to a full tree, classify clamps those buckets back
+            std::vector<T> padded = m_splitters;
+            padded.resize(m_leaves - 1, m_splitters.back());
+            m_tree.resize(m_leaves, m_splitters.back());
+            build(padded, 1, 0, padded.size());
+        }
+
+        //bucket 2b holds keys between splitters b - 1 and b, bucket 2b + 1 keys equal to splitter b
+        size_t buckets() const { return 2 * m_count + 1; }
+
+        size_t classify(const T& x) const
+        {
+            size_t j = 1;
+            for (size_t level = 0; level < m_levels; level++)
+                j = 2 * j + static_cast<size_t>(m_comp(m_tree[j], x));
+            size_t b = std::min(j - m_leaves, m_count);
+            bool equal = b < m_count && !m_comp(x, m_splitters[b]);
+            return 2 * b + static_cast<size_t>(equal);
+        }
+
+    private:
+        void build(const std::vector<T>& sorted, size_t node, size_t lo, size_t hi)
+        {
+            if (lo >= hi) return;
+            size_t mid = lo + (hi - lo) / 2;
+            m_tree[node] = sorted[mid];
+            build(sorted, 2 * node, lo, mid);
+            build(sorted, 2 * node + 1, mid + 1, hi);
+        }
+
+        Compare m_comp;
+        std::vector<T> m_splitters;
+        std::vector<T> m_tree;
+        size_t m_count;
+        size_t m_leaves;
+        size_t m_levels;
+    };
+
+    //parallel super scalar sample sort: splitters come from a sorted oversample, every thread classifies its chunk
+    //with the splitter tree, the elements are scattered to their buckets in parallel and the buckets are sorted
+    //concurrently. keys equal to a splitter get their own bucket, so skewed inputs stay balanced
+    template <typename T, typename Compare>
+    void sample_sort(T* first, T* last, Compare comp, unsigned threads = 0)
+    {
+        size_t len = last - first;
+        if (threads == 0) threads = DefaultThreadCount();
+        if (len < PARALLEL_MIN_CHUNK)
+        {
+            val::sort(first, last, comp);
+            return;
+        }
+        threads = static_cast<unsigned>(std::clamp<size_t>(len / PARALLEL_MIN_CHUNK, 1, threads));
+
+        size_t buckets = std::clamp<size_t>(std::bit_ceil(size_t(8) * threads), 16, SAMPLE_SORT_MAX_BUCKETS);
+        std::vector<T> sample;
+        {
+            std::mt19937_64 gen(len);
+            std::uniform_int_distribution<size_t> pos(0, len - 1);
+            size_t sampleSize = buckets * SAMPLE_OVERSAMPLING - 1;
+            sample.reserve(sampleSize);
+            for (size_t i = 0; i < sampleSize; i++) sample.push_back(first[pos(gen)]);
+        }
+        val::sort(sample.data(), sample.data() + sample.size(), comp);
+        std::vector<T> splitters;
+        for (size_t i = SAMPLE_OVERSAMPLING - 1; i < sample.size(); i += SAMPLE_OVERSAMPLING)
+        {
+            if (splitters.empty() || comp(splitters.back(), sample[i])) splitters.push_back(sample[i]);
+        }
+        SplitterTree<T, Compare> tree(std::move(splitters), comp);
+        size_t bucketCount = tree.buckets();
+
+        auto boundary = [&](size_t t) { return len * t / threads; };
+        std::vector<uint16_t> oracle(len);
+        std::vector<size_t> counts(threads * bucketCount, 0);
+        ParallelFor(threads, [&](unsigned t)
+        {
+            size_t* count = counts.data() + t * bucketCount;
+            for (size_t i = boundary(t); i < boundary(t + 1); i++)
+            {
+                size_t b = tree.classify(first[i]);
+                oracle[i] = static_cast<uint16_t>(b);
+                count[b]++;
+            }
+        });
+
+        //bucket by bucket, thread by thread: where every thread writes its part of every bucket
+        std::vector<size_t> bucketBegin(bucketCount + 1);
+        std::vector<size_t> offsets(threads * bucketCount);
+        size_t offset = 0;
+        for (size_t b = 0; b < bucketCount; b++)
+        {
+            bucketBegin[b] = offset;
+            for (unsigned t = 0; t < threads; t++)
+            {
+                offsets[t * bucketCount + b] = offset;
+                offset += counts[t * bucketCount + b];
+            }
+        }
+        bucketBegin[bucketCount] = len;
+
+        std::vector<T> buffer(std::make_move_iterator(first), std::make_move_iterator(last));
+        ParallelFor(threads, [&](unsigned t)
+        {
+            size_t* out = offsets.data() + t * bucketCount;
+            for (size_t i = boundary(t); i < boundary(t + 1); i++)
+                first[out[oracle[i]]++] = std::move(buffer[i]);
+        });
+
+        //equality buckets are done, the rest is handed out largest first
+        std::vector<size_t> order;
+        for (size_t b = 0; b < bucketCount; b += 2) order.push_back(b);
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b)
+        {
+            return bucketBegin[a + 1] - bucketBegin[a] > bucketBegin[b + 1] - bucketBegin[b];
+        });
+        std::atomic<size_t> next{0};
+        ParallelFor(threads, [&](unsigned)
+        {
+            for (size_t i = next++; i < order.size(); i = next++)
+                val::sort(first + bucketBegin[order[i]], first + bucketBegin[order[i] + 1], comp);
+        });
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+
+namespace val
+{
+    //moves first[perm[i]] to position i for every i by following the cycles of perm,
+    //every element is moved once (plus one temporary per cycle). perm is left as the identity
+    template <std::random_access_iterator It, typename Index>
+    void ApplyPermutation(It first, std::vector<Index>& perm)
+    {
+        using T = std::iter_value_t<It>;
+        for (size_t i = 0; i < perm.size(); i++)
+        {
+            if (static_cast<size_t>(perm[i]) == i) continue;
+            T tmp = std::move(first[i]);
+            size_t j = i;
+            while (true)
+            {
+                size_t src = static_cast<size_t>(perm[j]);
+                perm[j] = static_cast<Index>(j);
+                if (src == i)
+                {
+                    first[j] = std::move(tmp);
+                    break;
+                }
+                first[j] = std::move(first[src]);
+                j = src;
+            }
+        }
+    }
+
+    //reorders [first, last) in place so that the element at position i is the old first[perm[i]],
+    //e.g. with the result of argsort. pass perm with std::move when it isn't needed afterwards.
+    //throws std::invalid_argument unless perm holds every index of the range exactly once
+    template <std::random_access_iterator It, typename Index>
+    void apply_permutation(It first, It last, std::vector<Index> perm)
+    {
+        size_t n = last - first;
+        if (perm.size() != n)
+            throw std::invalid_argument("permutation size doesn't match the range");
+        //the cycle walk never ends on a repeated index and goes out of the range on a too large one
+        std::vector<bool> seen(n, false);
+        for (Index p : perm)
+        {
+            size_t index = static_cast<size_t>(p);
+            if (index >= n || seen[index])
+                throw std::invalid_argument("not a permutation of the range's indices");
+            seen[index] = true;
+        }
+        ApplyPermutation(first, perm);
+    }
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <bit>
+#include <vector>
+#include "sort.hpp"
+
+namespace val
+{
+    //selection windows this small are finished with insertion sort
+    inline constexpr size_t SELECT_THRESHOLD = 16;
+    //partial_sort and top_k keep a heap of k elements while k <= n / HEAP_SELECT_RATIO
+    inline constexpr size_t HEAP_SELECT_RATIO = 16;
+
+    //heap with the largest element (by comp) on top
+    template <typename T, typename Compare>
+    void SiftDown(T* heap, size_t len, size_t i, Compare comp)
+    {
+        T val = std::move(heap[i]);
+        while (true)
+        {
+            size_t child = 2 * i + 1;
+            if (child >= len) break;
+            if (child + 1 < len && comp(heap[child], heap[child + 1])) ++child;
+            if (!comp(val, heap[child])) break;
+            heap[i] = std::move(heap[child]);
+            i = child;
+        }
+        heap[i] = std::move(val);
+    }
+
+    template <typename T, typename Compare>
+    void MakeHeap(T* heap, size_t len, Compare comp)
+    {
+        for (size_t i = len / 2; i-- > 0;)
+            SiftDown(heap, len, i, comp);
+    }
+
+    template <typename T, typename Compare>
+    void SortHeap(T* heap, size_t len, Compare comp)
+    {
+        for (size_t end = len; end > 1; end--)
+        {
+            std::swap(heap[0], heap[end - 1]);
+            SiftDown(heap, end - 1, 0, comp);
+        }
+    }
+
+    template <typename T, typename Compare>
+    void IntroSelect(T* first, T* nth, T* last, Compare comp, int depthBudget);
+
+    //worst case pivot: median of medians of groups of 5, moved to *first for HoarePartition
+    template <typename T, typename Compare>
+    void MedianOfMediansToFront(T* first, T* last, Compare comp)
+    {
+        size_t groups = 0;
+        for (T* group = first; group < last; group += 5)
+        {
+            T* groupEnd = std::min(group + 5, last);
+            InsertionSort(group, groupEnd, comp);
+            std::swap(first[groups++], group[(groupEnd - group) / 2]);
+        }
+        IntroSelect(first, first + groups / 2, first + groups, comp, 0);
+        std::swap(*first, first[groups / 2]);
+    }
+
+    //quickselect on HoarePartitionWithMedian, after depthBudget partitions it switches to median of medians
+    //pivots, so the worst case stays O(n)
+    template <typename T, typename Compare>
+    void IntroSelect(T* first, T* nth, T* last, Compare comp, int depthBudget)
+    {
+        while (static_cast<size_t>(last - first) > SELECT_THRESHOLD)
+        {
+            T* q;
+            if (depthBudget > 0)
+            {
+                depthBudget--;
+                q = HoarePartitionWithMedian(first, last, comp);
+            }
+            else
+            {
+                MedianOfMediansToFront(first, last, comp);
+                q = HoarePartition(first, last, comp);
+            }
+            //left includes q, right doesnt
+            if (nth <= q) last = q + 1;
+            else first = q + 1;
+        }
+        if (last - first > 1)
+            InsertionSort(first, last, comp);
+    }
+
+    //puts the element that would be at nth after sorting there,
+    //nothing before it is greater and nothing after it is less
+    template <typename T, typename Compare>
+    void nth_element(T* first, T* nth, T* last, Compare comp)
+    {
+        if (nth >= last || last - first < 2) return;
+        int depthBudget = 2 * std::bit_width(static_cast<size_t>(last - first));
+        IntroSelect(first, nth, last, comp, depthBudget);
+    }
+
+    //sorts the smallest middle - first elements into [first, middle), the rest is left in unspecified order
+    template <typename T, typename Compare>
+    void partial_sort(T* first, T* middle, T* last, Compare comp)
+    {
+        size_t k = middle - first;
+        size_t len = last - first;
+        if (k == 0) return;
+        if (k <= len / HEAP_SELECT_RATIO)
+        {
+            //keep the k smallest in a heap, its top is the largest of them
+            MakeHeap(first, k, comp);
+            for (T* p = middle; p < last; ++p)
+            {
+                if (comp(*p, *first))
+                {
+                    std::swap(*p, *first);
+                    SiftDown(first, k, 0, comp);
+                }
+            }
+            SortHeap(first, k, comp);
+            return;
+        }
+        if (middle < last) val::nth_element(first, middle - 1, last, comp);
+        val::sort(first, middle, comp);
+    }
+
+    //sorted copy of the k smallest elements (k largest with std::greater), the input isn't changed
+    template <typename T, typename Compare>
+    std::vector<T> top_k(const T* first, const T* last, size_t k, Compare comp)
+    {
+        size_t len = last - first;
+        k = std::min(k, len);
+        std::vector<T> result;
+        if (k == 0) return result;
+        if (k <= len / HEAP_SELECT_RATIO)
+        {
+            result.assign(first, first + k);
+            MakeHeap(result.data(), k, comp);
+            for (const T* p = first + k; p < last; ++p)
+            {
+                if (comp(*p, result[0]))
+                {
+                    result[0] = *p;
+                    SiftDown(result.data(), k, 0, comp);
+                }
+            }
+            SortHeap(result.data(), k, comp);
+            return result;
+        }
+        result.assign(first, last);
+        val::partial_sort(result.data(), result.data() + k, result.data() + len, comp);
+        result.resize(k);
+        return result;
+    }
+}
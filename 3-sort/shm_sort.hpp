@@ -0,0 +1,331 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <ctime>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "multiway_merge.hpp"
+#include "parallel_sort.hpp"
+#include "sort.hpp"
+
+namespace val
+{
+    namespace shm
+    {
+        inline constexpr uint64_t SEGMENT_MAGIC = 0x76616c5f73686d31; //"val_shm1"
+
+        //a waiting worker wakes up this often to check whether the sort was aborted
+        inline constexpr long ABORT_POLL_NS = 50'000'000;
+
+        [[noreturn]] inline void ThrowErrno(const std::string& what)
+        {
+            throw std::system_error(errno, std::system_category(), what);
+        }
+
+        //std::atomic::wait uses private futexes, which only work between threads of one process,
+        //so the barrier calls futex itself with the shared variant
+        inline void FutexWait(std::atomic<uint32_t>& word, uint32_t expected, long timeoutNs)
+        {
+            timespec timeout{0, timeoutNs};
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected, &timeout, nullptr, 0);
+        }
+
+        inline void FutexWakeAll(std::atomic<uint32_t>& word)
+        {
+            syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+        }
+
+        //thrown by a worker when another one failed. the data is still a permutation of the input, in no
+        //particular order (see shm_sort_worker)
+        struct Aborted : std::runtime_error
+        {
+            Aborted() : std::runtime_error("shared memory sort was aborted by another worker") {}
+        };
+
+        //lives in the segment, all zero (what ftruncate gives) is the initial state.
+        //the number of parties isn't stored: every worker passes the same count
+        struct Control
+        {
+            std::atomic<uint32_t> arrived;
+            std::atomic<uint32_t> generation;
+            std::atomic<uint32_t> aborted;
+            //set once every chunk is sorted into the scratch space, which from then on holds the whole input
+            std::atomic<uint32_t> merging;
+
+            void abort()
+            {
+                aborted.store(1);
+                generation.fetch_add(1);
+                FutexWakeAll(generation);
+            }
+
+            void barrier(unsigned parties)
+            {
+                uint32_t gen = generation.load();
+                if (aborted.load()) throw Aborted{};
+                if (arrived.fetch_add(1) + 1 == parties)
+                {
+                    arrived.store(0);
+                    generation.fetch_add(1);
+                    FutexWakeAll(generation);
+                    return;
+                }
+                while (generation.load() == gen) FutexWait(generation, gen, ABORT_POLL_NS);
+                if (aborted.load()) throw Aborted{};
+            }
+        };
+
+        struct Header
+        {
+            uint64_t magic;
+            uint64_t count;
+            uint64_t elementSize;
+            Control control;
+        };
+
+        static_assert(std::atomic<uint32_t>::is_always_lock_free, "the barrier needs address free atomics");
+
+        //data and scratch start on their own cache lines
+        inline constexpr size_t DATA_OFFSET = (sizeof(Header) + 63) / 64 * 64;
+    } //namespace shm
+
+    //POSIX shared memory segment with count elements to be sorted by shm_sort, plus the same amount of scratch space.
+    //the creating object unlinks the name when it goes away, mappings that are still open stay valid.
+    //T has to be trivially copyable, the processes only share its bytes
+    template <typename T>
+    class SharedSortSegment
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "elements are shared between processes as raw bytes");
+
+    public:
+        //name is a shm_open name like "/my_sort", fails if it already exists
+        static SharedSortSegment create(const std::string& name, size_t count)
+        {
+            int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+            if (fd < 0) shm::ThrowErrno("shm_open " + name);
+            size_t bytes = shm::DATA_OFFSET + 2 * count * sizeof(T);
+            if (ftruncate(fd, static_cast<off_t>(bytes)) != 0)
+            {
+                int error = errno;
+                close(fd);
+                shm_unlink(name.c_str());
+                errno = error;
+                shm::ThrowErrno("ftruncate " + name);
+            }
+            SharedSortSegment segment(name, fd, bytes, true);
+            segment.header().magic = shm::SEGMENT_MAGIC;
+            segment.header().count = count;
+            segment.header().elementSize = sizeof(T);
+            return segment;
+        }
+
+        //maps a segment created by another process
+        static SharedSortSegment open(const std::string& name)
+        {
+            int fd = shm_open(name.c_str(), O_RDWR, 0);
+            if (fd < 0) shm::ThrowErrno("shm_open " + name);
+            struct stat st;
+            if (fstat(fd, &st) != 0)
+            {
+                close(fd);
+                shm::ThrowErrno("fstat " + name);
+            }
+            SharedSortSegment segment(name, fd, static_cast<size_t>(st.st_size), false);
+            const shm::Header& h = segment.header();
+            if (segment.m_bytes < shm::DATA_OFFSET || h.magic != shm::SEGMENT_MAGIC || h.elementSize != sizeof(T) ||
+                segment.m_bytes < shm::DATA_OFFSET + 2 * h.count * sizeof(T))
+                throw std::runtime_error(name + " is not a shared sort segment of this element type");
+            return segment;
+        }
+
+        SharedSortSegment(SharedSortSegment&& other) noexcept
+            : m_name(std::move(other.m_name))
+            , m_base(std::exchange(other.m_base, nullptr))
+            , m_bytes(other.m_bytes)
+            , m_owner(std::exchange(other.m_owner, false))
+        {
+        }
+
+        SharedSortSegment& operator=(SharedSortSegment&&) = delete;
+        SharedSortSegment(const SharedSortSegment&) = delete;
+        SharedSortSegment& operator=(const SharedSortSegment&) = delete;
+
+        ~SharedSortSegment()
+        {
+            if (m_base) munmap(m_base, m_bytes);
+            if (m_owner) shm_unlink(m_name.c_str());
+        }
+
+        T* data() { return reinterpret_cast<T*>(static_cast<char*>(m_base) + shm::DATA_OFFSET); }
+        T* scratch() { return data() + size(); }
+        size_t size() const { return header().count; }
+        T* begin() { return data(); }
+        T* end() { return data() + size(); }
+
+        shm::Header& header() { return *static_cast<shm::Header*>(m_base); }
+        const shm::Header& header() const { return *static_cast<const shm::Header*>(m_base); }
+
+        //clears the barrier and a previous abort, only while no worker is running
+        void reset()
+        {
+            header().control.arrived.store(0);
+            header().control.aborted.store(0);
+            header().control.merging.store(0);
+        }
+
+    private:
+        SharedSortSegment(std::string name, int fd, size_t bytes, bool owner)
+            : m_name(std::move(name))
+            , m_bytes(bytes)
+            , m_owner(owner)
+        {
+            m_base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            int error = errno;
+            close(fd);
+            if (m_base == MAP_FAILED)
+            {
+                m_base = nullptr;
+                if (owner) shm_unlink(m_name.c_str());
+                errno = error;
+                shm::ThrowErrno("mmap " + m_name);
+            }
+        }
+
+        std::string m_name;
+        void* m_base = nullptr;
+        size_t m_bytes;
+        bool m_owner;
+    };
+
+    //the part of shm_sort done by worker rank of workers, every worker process calls it with the same workers
+    //and comp. each one sorts its chunk into the scratch space, then after a barrier merges its share of the
+    //output from all chunks (split by MultiwaySplit, merged with the loser tree) back into data.
+    //returns after the last barrier, when the whole segment is sorted. if any worker throws, the others throw
+    //shm::Aborted at their next barrier, call reset() before sorting the segment again.
+    //the merge only reads the scratch space, so a worker that fails during it copies its share of the sorted
+    //chunks back: once all have returned, data is a permutation of the input again. a worker that dies
+    //without unwinding can't do that, shm_sort then copies the whole scratch space back itself
+    template <typename T, typename Compare>
+    void shm_sort_worker(SharedSortSegment<T>& segment, unsigned rank, unsigned workers, Compare comp)
+    {
+        shm::Control& control = segment.header().control;
+        size_t len = segment.size();
+        auto boundary = [&](size_t w) { return len * w / workers; };
+        T* data = segment.data();
+        T* scratch = segment.scratch();
+
+        try
+        {
+            std::copy(data + boundary(rank), data + boundary(rank + 1), scratch + boundary(rank));
+            val::sort(scratch + boundary(rank), scratch + boundary(rank + 1), comp);
+            control.barrier(workers);
+            control.merging.store(1);
+
+            std::vector<SortedSequence<T>> chunks;
+            for (unsigned w = 0; w < workers; w++) chunks.push_back({scratch + boundary(w), scratch + boundary(w + 1)});
+            std::vector<size_t> from = MultiwaySplit(chunks, boundary(rank), comp);
+            std::vector<size_t> to = MultiwaySplit(chunks, boundary(rank + 1), comp);
+            std::vector<SortedSequence<T>> parts;
+            for (unsigned w = 0; w < workers; w++) parts.push_back({chunks[w].first + from[w], chunks[w].first + to[w]});
+            MultiwayMerge(parts, data + boundary(rank), comp);
+            control.barrier(workers);
+        }
+        catch (...)
+        {
+            if (control.merging.load())
+                std::copy(scratch + boundary(rank), scratch + boundary(rank + 1), data + boundary(rank));
+            control.abort();
+            throw;
+        }
+    }
+
+    //sorts the segment with processes forked worker processes, the calling process only waits for them.
+    //a worker that throws or dies aborts the others, then this throws
+    template <typename T, typename Compare>
+    void shm_sort(SharedSortSegment<T>& segment, unsigned processes, Compare comp)
+    {
+        processes = static_cast<unsigned>(std::clamp<size_t>(segment.size() / PARALLEL_MIN_CHUNK, 1, processes));
+        if (processes <= 1)
+        {
+            val::sort(segment.begin(), segment.end(), comp);
+            return;
+        }
+
+        segment.reset();
+        std::vector<pid_t> children;
+        for (unsigned rank = 0; rank < processes; rank++)
+        {
+            pid_t pid = fork();
+            if (pid == 0)
+            {
+                int status = 0;
+                try
+                {
+                    shm_sort_worker(segment, rank, processes, comp);
+                }
+                catch (...)
+                {
+                    status = 1;
+                }
+                _exit(status);
+            }
+            if (pid < 0)
+            {
+                int error = errno;
+                segment.header().control.abort();
+                for (pid_t child : children) waitpid(child, nullptr, 0);
+                errno = error;
+                shm::ThrowErrno("fork");
+            }
+            children.push_back(pid);
+        }
+
+        //polled instead of a blocking wait: the workers have to be told as soon as any of them dies,
+        //and wait() for any child could reap children that aren't ours
+        bool failed = false;
+        while (!children.empty())
+        {
+            for (size_t c = 0; c < children.size();)
+            {
+                int status;
+                pid_t pid = waitpid(children[c], &status, WNOHANG);
+                if (pid == 0 || (pid < 0 && errno == EINTR))
+                {
+                    c++;
+                    continue;
+                }
+                if (pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                {
+                    if (!failed) segment.header().control.abort();
+                    failed = true;
+                }
+                children.erase(children.begin() + c);
+            }
+            if (!children.empty()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (failed)
+        {
+            //a killed worker left its share of data half merged, the scratch space still has all elements
+            if (segment.header().control.merging.load())
+                std::copy(segment.scratch(), segment.scratch() + segment.size(), segment.data());
+            throw std::runtime_error("a shared memory sort worker failed");
+        }
+    }
+}
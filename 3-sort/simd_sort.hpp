@@ -0,0 +1,221 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <type_traits>
+
+//vectorized base case: bitonic sorting networks on AVX2 registers
+//only compiled for x86 with GCC/Clang, the avx2 code is enabled per function with the target attribute
+//so the rest of the program doesn't need -mavx2 and the choice is made at runtime
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define VAL_SIMD_SORT_AVX2 1
+#include <immintrin.h>
+#define VAL_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define VAL_SIMD_SORT_AVX2 0
+#endif
+
+namespace val
+{
+    //largest partition the network can take: 8 registers of int32 or 16 registers of int64
+    inline constexpr size_t SIMD_SORT_MAX = 64;
+
+    //min/max networks only give the same result as comp for plain < on signed 32/64 bit keys
+    template <typename T, typename Compare>
+    inline constexpr bool SimdSortEligible =
+        std::is_integral_v<T> && std::is_signed_v<T> && (sizeof(T) == 4 || sizeof(T) == 8) &&
+        (std::is_same_v<Compare, std::less<T>> || std::is_same_v<Compare, std::less<>> ||
+         std::is_same_v<Compare, std::ranges::less>);
+
+    inline bool SimdSortAvailable()
+    {
+#if VAL_SIMD_SORT_AVX2
+        static const bool avx2 = __builtin_cpu_supports("avx2");
+        return avx2;
+#else
+        return false;
+#endif
+    }
+
+#if VAL_SIMD_SORT_AVX2
+    namespace simd
+    {
+        //during stage (K, J) of bitonic sort lane i is compared with lane i ^ J,
+        //the bit is set for lanes that have to keep the max of the pair
+        constexpr unsigned BitonicMaxMask(int lanes, int k, int j)
+        {
+            unsigned mask = 0;
+            for (int i = 0; i < lanes; i++)
+            {
+                bool upper = (i & j) != 0;
+                bool descending = (i & k) != 0;
+                if (upper != descending) mask |= 1u << i;
+            }
+            return mask;
+        }
+
+        struct Avx2Int32
+        {
+            using V = __m256i;
+            static constexpr int LANES = 8;
+
+            VAL_TARGET_AVX2 static V Load(const void* p) { return _mm256_load_si256(static_cast<const V*>(p)); }
+            VAL_TARGET_AVX2 static void Store(void* p, V v) { _mm256_store_si256(static_cast<V*>(p), v); }
+            VAL_TARGET_AVX2 static V Min(V a, V b) { return _mm256_min_epi32(a, b); }
+            VAL_TARGET_AVX2 static V Max(V a, V b) { return _mm256_max_epi32(a, b); }
+
+            VAL_TARGET_AVX2 static V Reverse(V v)
+            {
+                return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+            }
+
+            template <int K, int J>
+            VAL_TARGET_AVX2 static V Stage(V v)
+            {
+                V partner = _mm256_permutevar8x32_epi32(
+                    v, _mm256_setr_epi32(0 ^ J, 1 ^ J, 2 ^ J, 3 ^ J, 4 ^ J, 5 ^ J, 6 ^ J, 7 ^ J));
+                constexpr int mask = BitonicMaxMask(LANES, K, J);
+                return _mm256_blend_epi32(Min(v, partner), Max(v, partner), mask);
+            }
+
+            //ascending bitonic merge of a single register
+            VAL_TARGET_AVX2 static V Clean(V v)
+            {
+                v = Stage<8, 4>(v);
+                v = Stage<8, 2>(v);
+                return Stage<8, 1>(v);
+            }
+
+            VAL_TARGET_AVX2 static V SortRegister(V v)
+            {
+                v = Stage<2, 1>(v);
+                v = Stage<4, 2>(v);
+                v = Stage<4, 1>(v);
+                return Clean(v);
+            }
+        };
+
+        struct Avx2Int64
+        {
+            using V = __m256i;
+            static constexpr int LANES = 4;
+
+            VAL_TARGET_AVX2 static V Load(const void* p) { return _mm256_load_si256(static_cast<const V*>(p)); }
+            VAL_TARGET_AVX2 static void Store(void* p, V v) { _mm256_store_si256(static_cast<V*>(p), v); }
+
+            //no min/max for 64 bit lanes before avx512
+            VAL_TARGET_AVX2 static V Min(V a, V b) { return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b)); }
+            VAL_TARGET_AVX2 static V Max(V a, V b) { return _mm256_blendv_epi8(b, a, _mm256_cmpgt_epi64(a, b)); }
+
+            VAL_TARGET_AVX2 static V Reverse(V v) { return _mm256_permute4x64_epi64(v, _MM_SHUFFLE(0, 1, 2, 3)); }
+
+            //blend works on 32 bit lanes, so every 64 bit lane takes two mask bits
+            static constexpr int WideMask(unsigned mask)
+            {
+                int wide = 0;
+                for (int i = 0; i < LANES; i++)
+                    if (mask & (1u << i)) wide |= 3 << (2 * i);
+                return wide;
+            }
+
+            template <int K, int J>
+            VAL_TARGET_AVX2 static V Stage(V v)
+            {
+                V partner = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3 ^ J, 2 ^ J, 1 ^ J, 0 ^ J));
+                constexpr int mask = WideMask(BitonicMaxMask(LANES, K, J));
+                return _mm256_blend_epi32(Min(v, partner), Max(v, partner), mask);
+            }
+
+            VAL_TARGET_AVX2 static V Clean(V v)
+            {
+                v = Stage<4, 2>(v);
+                return Stage<4, 1>(v);
+            }
+
+            VAL_TARGET_AVX2 static V SortRegister(V v)
+            {
+                v = Stage<2, 1>(v);
+                return Clean(v);
+            }
+        };
+
+        //merges two sorted runs of width registers each (v[0..width) and v[width..2*width))
+        template <typename Ops>
+        VAL_TARGET_AVX2 inline void MergeRuns(typename Ops::V* v, int width)
+        {
+            using V = typename Ops::V;
+            //comparing a with reversed b splits them into two bitonic halves, everything in lo <= everything in hi
+            for (int t = 0; t < width; t++)
+            {
+                V a = v[t];
+                V b = Ops::Reverse(v[2 * width - 1 - t]);
+                v[t] = Ops::Min(a, b);
+                v[2 * width - 1 - t] = Ops::Reverse(Ops::Max(a, b));
+            }
+            //reversing hi back keeps the halves bitonic, clean them down to register distance 1
+            for (int half = 0; half < 2 * width; half += width)
+            {
+                for (int d = width / 2; d > 0; d /= 2)
+                {
+                    for (int s = half; s < half + width; s++)
+                    {
+                        if (s & d) continue;
+                        V lo = Ops::Min(v[s], v[s + d]);
+                        V hi = Ops::Max(v[s], v[s + d]);
+                        v[s] = lo;
+                        v[s + d] = hi;
+                    }
+                }
+            }
+            for (int s = 0; s < 2 * width; s++)
+                v[s] = Ops::Clean(v[s]);
+        }
+
+        template <typename Ops, typename T, int REGS>
+        VAL_TARGET_AVX2 void SortBlock(T* first, size_t len)
+        {
+            using V = typename Ops::V;
+            constexpr size_t CAPACITY = REGS * Ops::LANES;
+
+            //the tail is padded with max so it stays at the end
+            alignas(32) T buf[CAPACITY];
+            std::copy(first, first + len, buf);
+            std::fill(buf + len, buf + CAPACITY, std::numeric_limits<T>::max());
+
+            V v[REGS];
+            for (int r = 0; r < REGS; r++)
+                v[r] = Ops::SortRegister(Ops::Load(buf + r * Ops::LANES));
+            for (int width = 1; width < REGS; width *= 2)
+                for (int base = 0; base < REGS; base += 2 * width)
+                    MergeRuns<Ops>(v + base, width);
+            for (int r = 0; r < REGS; r++)
+                Ops::Store(buf + r * Ops::LANES, v[r]);
+
+            std::copy(buf, buf + len, first);
+        }
+    } //namespace simd
+#endif
+
+    //sorts up to SIMD_SORT_MAX elements, check SimdSortAvailable() before calling
+    template <typename T>
+    void SimdSort(T* first, T* last)
+    {
+        static_assert(SimdSortEligible<T, std::less<T>>, "SimdSort works with signed 32/64 bit integers");
+#if VAL_SIMD_SORT_AVX2
+        using Ops = std::conditional_t<sizeof(T) == 4, simd::Avx2Int32, simd::Avx2Int64>;
+        size_t len = last - first;
+        size_t regs = (len + Ops::LANES - 1) / Ops::LANES;
+
+        //smallest power of two register count that fits
+        if (regs <= 1) simd::SortBlock<Ops, T, 1>(first, len);
+        else if (regs <= 2) simd::SortBlock<Ops, T, 2>(first, len);
+        else if (regs <= 4) simd::SortBlock<Ops, T, 4>(first, len);
+        else if (regs <= 8) simd::SortBlock<Ops, T, 8>(first, len);
+        else simd::SortBlock<Ops, T, SIMD_SORT_MAX / Ops::LANES>(first, len);
+#else
+        std::sort(first, last);
+#endif
+    }
+}
@@ -1,16 +1,63 @@
 #pragma once
 
+#include <functional>
+#include <iterator>
 #include <memory>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <utility>
+#include "simd_sort.hpp"
+#include "sort_stats.hpp"
 
 namespace val
 {
     inline constexpr size_t INSERTION_THRESHOLD = 200;
 
+    //comparators that mean plain operator<, key specific fast paths only kick in for those
+    template <typename Compare, typename T>
+    inline constexpr bool IsPlainLess =
+        std::is_same_v<Compare, std::less<T>> || std::is_same_v<Compare, std::less<>> ||
+        std::is_same_v<Compare, std::ranges::less>;
 
-    template <typename T, typename Compare>
-    void InsertionSort(T* first, T* last, Compare comp)
+    template <typename T>
+    inline constexpr bool IsStringKey = std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>;
+
+    //string_sort.hpp, included at the end
+    template <typename T>
+    void StringSort(T* first, T* last);
+
+    enum class PartitionScheme
+    {
+        Hoare,            //HoarePartitionWithMedian
+        Lomuto,           //Partition
+        BranchlessLomuto, //BranchlessPartition, plain Lomuto for types that aren't cheap to copy
+    };
+
+    //per key type settings used by val::sort, specializations come from the header written by sort_tune
+    template <typename T>
+    struct SortTuning
     {
-        if (!first || !last) return;
+        static constexpr bool tuned = false;
+        static constexpr size_t insertionThreshold = INSERTION_THRESHOLD;
+        static constexpr PartitionScheme partition = PartitionScheme::Hoare;
+    };
+}
+
+#if __has_include("sort_tuning.hpp")
+#include "sort_tuning.hpp"
+#endif
+
+namespace val
+{
+
+    //every engine works on random access iterators, contiguous ones are turned into plain pointers by val::sort
+    //the trailing stats argument is the instrumentation policy from sort_stats.hpp
+    template <std::random_access_iterator It, typename Compare, typename Stats = NoInstrumentation>
+    void InsertionSort(It first, It last, Compare comp, Stats&& stats = {})
+    {
+        using T = std::iter_value_t<It>;
+        if (last - first < 2) return;
         size_t len = last - first;
         for (int i = 1; i < len; i++)
         {
@@ -21,15 +68,47 @@ namespace val
                 first[j + 1] = std::move(first[j]);
             }
             first[j + 1] = std::move(val);
+            stats.move(i - j + 1);
+        }
+    }
+
+    //base case for partitions below SmallSortThreshold
+    template <std::random_access_iterator It, typename Compare, typename Stats = NoInstrumentation>
+    void SmallSort(It first, It last, Compare comp, Stats&& stats = {})
+    {
+        if constexpr (std::is_pointer_v<It> && SimdSortEligible<std::iter_value_t<It>, Compare>)
+        {
+            if (static_cast<size_t>(last - first) <= SIMD_SORT_MAX && SimdSortAvailable())
+            {
+                SimdSort(first, last);
+                return;
+            }
+        }
+        InsertionSort(first, last, comp, stats);
+    }
+
+    //the network is cheaper than insertion sort up to its own size, so partitioning goes further down for it
+    //(unless the type was tuned for this machine)
+    template <std::random_access_iterator It, typename Compare>
+    size_t SmallSortThreshold()
+    {
+        if constexpr (SortTuning<std::iter_value_t<It>>::tuned)
+        {
+            return SortTuning<std::iter_value_t<It>>::insertionThreshold;
+        }
+        else if constexpr (std::is_pointer_v<It> && SimdSortEligible<std::iter_value_t<It>, Compare>)
+        {
+            if (SimdSortAvailable()) return SIMD_SORT_MAX;
         }
+        return INSERTION_THRESHOLD;
     }
 
-    template <typename T, typename Compare>
-    T* GetMedian(T* first, T* last, Compare comp)
+    template <std::random_access_iterator It, typename Compare>
+    It GetMedian(It first, It last, Compare comp)
     {
         int len = last - first;
         if (len < 3) return last - 1;
-        T* mid = first + (len / 2);
+        It mid = first + (len / 2);
         //find max of 3
         if (comp(*first, *mid))
         {
@@ -65,16 +144,18 @@ namespace val
         }
     }
 
-    template <typename T, typename Compare>
-    T* HoarePartition(T* first, T* last, Compare comp)
+    //i starts at first instead of first - 1 (which isn't a valid iterator for most containers),
+    //the first scan doesn't pre-increment and every swap advances i instead
+    template <std::random_access_iterator It, typename Compare, typename Stats = NoInstrumentation>
+    It HoarePartition(It first, It last, Compare comp, Stats&& stats = {})
     {
-        T* pivotPos = first;
+        It pivotPos = first;
 
         //median
-        //pivotPos = GetMedian<T>(first, last, comp);
-        T pivotVal = *pivotPos;
-        T* i = first - 1;
-        T* j = last;
+        //pivotPos = GetMedian(first, last, comp);
+        std::iter_value_t<It> pivotVal = *pivotPos;
+        It i = first;
+        It j = last;
 
         while (true)
         {
@@ -83,62 +164,40 @@ namespace val
                 --j;
             }
             while (comp(pivotVal, *j));
-            do
+            while (comp(*i, pivotVal))
             {
                 ++i;
             }
-            while (comp(*i, pivotVal));
             if (i >= j)
                 return j;
-            std::swap(*i, *j);
+            CountedSwap(i, j, stats);
+            ++i;
         }
     }
 
-    template <typename T, typename Compare>
-    T* HoarePartitionWithMedian(T* first, T* last, Compare comp)
+    template <std::random_access_iterator It, typename Compare, typename Stats = NoInstrumentation>
+    It HoarePartitionWithMedian(It first, It last, Compare comp, Stats&& stats = {})
     {
-        T* pivotPos = first;
-
         //median
-        std::swap(*GetMedian<T>(first, last, comp), *first);
-
-
-        T pivotVal = *pivotPos;
-        T* i = first - 1;
-        T* j = last;
+        CountedSwap(GetMedian(first, last, comp), first, stats);
 
-        while (true)
-        {
-            do
-            {
-                --j;
-            }
-            while (comp(pivotVal, *j));
-            do
-            {
-                ++i;
-            }
-            while (comp(*i, pivotVal));
-            if (i >= j)
-                return j;
-            std::swap(*i, *j);
-        }
+        return HoarePartition(first, last, comp, stats);
     }
 
-    template <typename T, typename Compare>
-    T* Partition(T* first, T* last, Compare comp)
+    template <std::random_access_iterator It, typename Compare, typename Stats = NoInstrumentation>
+    It Partition(It first, It last, Compare comp, Stats&& stats = {})
     {
         int len = last - first;
 
-        T* pivot;
+        It pivot;
 
 
         //middle element pivot
         //pivot = first + (len / 2);
 
         //get median and put it to the end
-        pivot = GetMedian<T>(first, last, comp);
-        std::swap(*pivot, first[len - 1]);
+        pivot = GetMedian(first, last, comp);
+        CountedSwap(pivot, first + (len - 1), stats);
 
         //last element pivot
         pivot = first + len - 1;
@@ -148,95 +207,240 @@ namespace val
         {
             if (comp(first[j], *pivot))
             {
-                std::swap(first[++i], first[j]);
+                CountedSwap(first + (++i), first + j, stats);
             }
         }
-        std::swap(first[++i], first[len - 1]);
+        CountedSwap(first + (++i), first + (len - 1), stats);
         return (first + i);
     }
 
+    //types BranchlessPartition copies around instead of swapping
+    template <typename T>
+    inline constexpr bool BranchlessPartitionable = std::is_trivially_copyable_v<T> && sizeof(T) <= 16;
+
+    //Lomuto with the median pivot at first and no branch on the comparison: every element is written to the
+    //boundary and the boundary element to its place, only the boundary moves by comp's result.
+    //if the element was >= pivot both belong to the right part anyway. one forward pass, no mispredictions
+    template <std::random_access_iterator It, typename Compare, typename Stats = NoInstrumentation>
+    It BranchlessPartition(It first, It last, Compare comp, Stats&& stats = {})
+    {
+        using T = std::iter_value_t<It>;
+        static_assert(BranchlessPartitionable<T>);
+        size_t len = last - first;
+        CountedSwap(GetMedian(first, last, comp), first, stats);
+
+        const T pivot = *first;
+        size_t boundary = 1;
+        for (size_t i = 1; i < len; i++)
+        {
+            T x = first[i];
+            bool less = comp(x, pivot);
+            first[i] = first[boundary];
+            first[boundary] = x;
+            boundary += less;
+        }
+        stats.move(2 * (len - 1));
+
+        It q = first + (boundary - 1);
+        CountedSwap(first, q, stats);
+        return q;
+    }
 
-    template <typename T, typename Compare>
-    void QuickSort(T* first, T* last, Compare comp)
+    template <std::random_access_iterator It, typename Compare, typename Stats = NoInstrumentation>
+    void QuickSort(It first, It last, Compare comp, Stats&& stats = {})
     {
+        RecursionScope scope(stats);
         if (last - first <= 1) return;
-        T* q = HoarePartitionWithMedian(first, last, comp);
-        QuickSort(first, q + 1, comp);
-        QuickSort(q + 1, last, comp);
+        It q = HoarePartitionWithMedian(first, last, comp, stats);
+        stats.partition((q + 1) - first, last - (q + 1));
+        QuickSort(first, q + 1, comp, stats);
+        QuickSort(q + 1, last, comp, stats);
     }
 
-    template <typename T, typename Compare>
-    void QuickSortHoareNoTailRecursion(T* first, T* last, Compare comp)
+    template <std::random_access_iterator It, typename Compare, typename Stats = NoInstrumentation>
+    void QuickSortHoareNoTailRecursion(It first, It last, Compare comp, Stats&& stats = {})
     {
+        RecursionScope scope(stats);
         while (last - first > 1)
         {
-            T* q = HoarePartitionWithMedian(first, last, comp);
+            It q = HoarePartitionWithMedian(first, last, comp, stats);
 
             //left includes q, right doesnt
             size_t left = (q+1)-first;
             size_t right = last - (q+1);
+            stats.partition(left, right);
             if (left < right)
             {
-                QuickSortHoareNoTailRecursion(first, q + 1, comp);
+                QuickSortHoareNoTailRecursion(first, q + 1, comp, stats);
                 first=q+1;
             }
             else
             {
-                QuickSortHoareNoTailRecursion(q + 1, last, comp);
+                QuickSortHoareNoTailRecursion(q + 1, last, comp, stats);
                 last = q + 1;
             }
         }
     }
 
-    template <typename T, typename Compare>
-    void HybridSort(T* first, T* last, Compare comp)
+    template <std::random_access_iterator It, typename Compare, typename Stats = NoInstrumentation>
+    void HybridSort(It first, It last, Compare comp, Stats&& stats = {})
     {
+        RecursionScope scope(stats);
         size_t len = last - first;
-        if (len <= INSERTION_THRESHOLD)
+        if (len <= SmallSortThreshold<It, Compare>())
         {
             if (len > 1)
-                InsertionSort(first, last, comp);
+                SmallSort(first, last, comp, stats);
             return;
         }
-        T* q = HoarePartitionWithMedian(first, last, comp);
+        It q = HoarePartitionWithMedian(first, last, comp, stats);
+        stats.partition((q + 1) - first, last - (q + 1));
         //if (q - first < last - q)
-        HybridSort(first, q + 1, comp);
-        HybridSort(q + 1, last, comp);
+        HybridSort(first, q + 1, comp, stats);
+        HybridSort(q + 1, last, comp, stats);
     }
 
-    template <typename T, typename Compare>
-    void HybridSortNoTailRecursion(T* first, T* last, Compare comp)
+    //splits [first, last) into [first, leftEnd) and [rightBegin, last), everything between is in place
+    template <PartitionScheme Scheme, std::random_access_iterator It, typename Compare, typename Stats = NoInstrumentation>
+    std::pair<It, It> PartitionStep(It first, It last, Compare comp, Stats&& stats = {})
     {
-        while (last - first > INSERTION_THRESHOLD)
+        if constexpr (Scheme == PartitionScheme::Hoare)
         {
-            T* q = HoarePartitionWithMedian(first, last, comp);
-            //T* q = Partition(first, last, comp);
-
             //left includes q, right doesnt
-            size_t left = (q+1)-first;
-            size_t right = last - (q+1);
+            It q = HoarePartitionWithMedian(first, last, comp, stats);
+            return {q + 1, q + 1};
+        }
+        else
+        {
+            It q;
+            if constexpr (Scheme == PartitionScheme::BranchlessLomuto &&
+                          BranchlessPartitionable<std::iter_value_t<It>>)
+            {
+                q = BranchlessPartition(first, last, comp, stats);
+            }
+            else
+            {
+                q = Partition(first, last, comp, stats);
+            }
+            It rightBegin = q + 1;
+            //nothing was less than the pivot: pull the keys equal to it next to it,
+            //otherwise lomuto goes quadratic on duplicates
+            if (q == first)
+            {
+                for (It p = rightBegin; p != last; ++p)
+                {
+                    if (!comp(*q, *p)) CountedSwap(p, rightBegin++, stats);
+                }
+            }
+            return {q, rightBegin};
+        }
+    }
+
+    //threshold and scheme are parameters so sort_tune can try them, val::sort passes the tuned ones
+    template <PartitionScheme Scheme = PartitionScheme::Hoare, std::random_access_iterator It, typename Compare,
+              typename Stats = NoInstrumentation>
+    void HybridSortNoTailRecursion(It first, It last, Compare comp,
+                                   size_t threshold = SmallSortThreshold<It, Compare>(), Stats&& stats = {})
+    {
+        RecursionScope scope(stats);
+        while (static_cast<size_t>(last - first) > threshold)
+        {
+            auto [leftEnd, rightBegin] = PartitionStep<Scheme>(first, last, comp, stats);
+
+            size_t left = leftEnd - first;
+            size_t right = last - rightBegin;
+            stats.partition(left, right);
+            stats.sorted(rightBegin - leftEnd);
             if (left < right)
             {
-                HybridSortNoTailRecursion(first, q + 1, comp);
-                first=q+1;
+                HybridSortNoTailRecursion<Scheme>(first, leftEnd, comp, threshold, stats);
+                first = rightBegin;
             }
             else
             {
-                HybridSortNoTailRecursion(q + 1, last, comp);
-                last = q + 1;
+                HybridSortNoTailRecursion<Scheme>(rightBegin, last, comp, threshold, stats);
+                last = leftEnd;
             }
         }
         if (last - first > 1)
-            InsertionSort(first, last, comp);
+            SmallSort(first, last, comp, stats);
+        stats.sorted(last - first);
     }
 
     //As with std::, last is expected to be the next pos after the final element
-    template <typename T, typename Compare>
-    void sort(T* first, T* last, Compare comp)
+    //pass a SortCounters as stats to count what the sort does, runs with a policy other than NoInstrumentation
+    //always take the comparison engine
+    template <std::random_access_iterator It, typename Compare, typename Stats>
+    void sort(It first, It last, Compare comp, Stats&& stats)
+    {
+        if constexpr (std::contiguous_iterator<It> && !std::is_pointer_v<It>)
+        {
+            //vector/array/span iterators take the pointer path (and its SIMD base case)
+            auto* data = std::to_address(first);
+            sort(data, data + (last - first), comp, stats);
+        }
+        else if constexpr (std::remove_cvref_t<Stats>::enabled)
+        {
+            auto counted = InstrumentedCompare(comp, stats);
+            HybridSortNoTailRecursion<SortTuning<std::iter_value_t<It>>::partition>(
+                first, last, counted, SmallSortThreshold<It, decltype(counted)>(), stats);
+        }
+        else if constexpr (std::is_pointer_v<It> && IsStringKey<std::iter_value_t<It>> &&
+                           IsPlainLess<Compare, std::iter_value_t<It>> &&
+                           std::is_same_v<std::remove_cvref_t<Stats>, NoInstrumentation>)
+        {
+            StringSort(first, last);
+        }
+        else
+        {
+            HybridSortNoTailRecursion<SortTuning<std::iter_value_t<It>>::partition>(
+                first, last, comp, SmallSortThreshold<It, Compare>(), stats);
+            //QuickSort(first, last, comp);
+            //QuickSortHoareNoTailRecursion(first,last,comp);
+        }
+    }
+
+    template <std::random_access_iterator It, typename Compare>
+    void sort(It first, It last, Compare comp)
     {
-        HybridSortNoTailRecursion(first, last, comp);
-        //QuickSort(first, last, comp);
-        //QuickSortHoareNoTailRecursion(first,last,comp);
+        sort(first, last, comp, NoInstrumentation{});
+    }
+
+    //compares proj(a) and proj(b), std::identity leaves comp as it is so it stays recognizable for fast paths
+    template <typename Compare, typename Proj>
+    auto ProjectedCompare(Compare comp, Proj proj)
+    {
+        if constexpr (std::is_same_v<Proj, std::identity>)
+        {
+            return comp;
+        }
+        else
+        {
+            return [comp, proj](const auto& a, const auto& b) mutable
+            {
+                return std::invoke(comp, std::invoke(proj, a), std::invoke(proj, b));
+            };
+        }
+    }
+
+    template <std::ranges::random_access_range R, typename Compare = std::ranges::less, typename Proj = std::identity>
+        requires std::sortable<std::ranges::iterator_t<R>, Compare, Proj>
+    void sort(R&& range, Compare comp = {}, Proj proj = {})
+    {
+        auto first = std::ranges::begin(range);
+        auto last = std::ranges::next(first, std::ranges::end(range));
+        sort(first, last, ProjectedCompare(comp, proj));
+    }
+
+    //containers that only expose their storage through data() and size(), like Array from lab 2
+    template <typename C, typename Compare = std::ranges::less, typename Proj = std::identity>
+        requires (!std::ranges::random_access_range<C>) && requires(C& c) { std::ranges::data(c); std::ranges::size(c); }
+    void sort(C& container, Compare comp = {}, Proj proj = {})
+    {
+        auto* data = std::ranges::data(container);
+        sort(data, data + std::ranges::size(container), ProjectedCompare(comp, proj));
     }
 
 }
+
+#include "string_sort.hpp"
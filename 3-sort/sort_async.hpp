@@ -0,0 +1,106 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <stop_token>
+#include <thread>
+#include "sort.hpp"
+
+namespace val
+{
+    enum class SortStatus
+    {
+        Completed,
+        Cancelled, //the range holds the same elements in some partially sorted order
+    };
+
+    //called with the number of elements in their final position and the total
+    using SortProgressCallback = std::function<void(size_t sorted, size_t total)>;
+
+    //runs every task on a new detached thread, the default executor of sort_async
+    struct NewThreadExecutor
+    {
+        void operator()(std::function<void()> task) const
+        {
+            std::thread(std::move(task)).detach();
+        }
+    };
+
+    namespace async
+    {
+        //thrown from a checkpoint to unwind the sort, never leaves sort_async
+        struct Cancelled
+        {
+        };
+
+        //instrumentation policy used as the checkpoint of HybridSortNoTailRecursion:
+        //every partition step checks the stop token, finished elements are reported about every percent
+        class Control : public NoInstrumentation
+        {
+        public:
+            Control(std::stop_token stop, SortProgressCallback progress, size_t total)
+                : m_stop(std::move(stop))
+                , m_progress(std::move(progress))
+                , m_total(total)
+                , m_step(std::max<size_t>(total / 100, 1))
+                , m_nextReport(m_step)
+            {
+            }
+
+            void checkpoint() const
+            {
+                if (m_stop.stop_requested()) throw Cancelled{};
+            }
+
+            void partition(size_t, size_t) { checkpoint(); }
+
+            void sorted(size_t n)
+            {
+                m_sorted += n;
+                if (m_progress && (m_sorted >= m_nextReport || m_sorted == m_total))
+                {
+                    m_progress(m_sorted, m_total);
+                    m_nextReport = m_sorted + m_step;
+                }
+            }
+
+        private:
+            std::stop_token m_stop;
+            SortProgressCallback m_progress;
+            size_t m_total;
+            size_t m_step;
+            size_t m_nextReport;
+            size_t m_sorted = 0;
+        };
+    } //namespace async
+
+    //sorts [first, last) on executor (anything callable with a std::function<void()>) and returns its status.
+    //stop is checked before every partition step, so a cancelled sort stops within one partition pass.
+    //the range has to stay alive until the future is ready, exceptions from comp come out of future.get()
+    template <std::random_access_iterator It, typename Compare, typename Executor = NewThreadExecutor>
+    std::future<SortStatus> sort_async(It first, It last, Compare comp, Executor executor = {},
+                                       std::stop_token stop = {}, SortProgressCallback progress = {})
+    {
+        auto task = std::make_shared<std::packaged_task<SortStatus()>>(
+            [=, stop = std::move(stop), progress = std::move(progress)]() mutable
+            {
+                async::Control control(std::move(stop), std::move(progress), last - first);
+                try
+                {
+                    control.checkpoint();
+                    val::sort(first, last, comp, control);
+                }
+                catch (const async::Cancelled&)
+                {
+                    return SortStatus::Cancelled;
+                }
+                return SortStatus::Completed;
+            });
+        std::future<SortStatus> result = task->get_future();
+        executor([task] { (*task)(); });
+        return result;
+    }
+}
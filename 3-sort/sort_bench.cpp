@@ -0,0 +1,463 @@
+//benchmarks every sort engine over a matrix of input distributions, sizes and key types,
+//writes the results as csv / json and compares them with a stored baseline to flag regressions
+//usage: sort_bench [--sizes 1000,100000] [--types i32,i64,f64,str] [--engines val_sort,std_sort,...]
+//                  [--dists random,sorted,...] [--reps N] [--warmups N] [--csv out.csv] [--json out.json]
+//                  [--baseline path.csv] [--no-baseline | --save-baseline] [--tolerance 0.15] [--quick]
+//the sort_each / sort_many_Nt engines cut the input into many small arrays and sort each one, with a loop of
+//val::sort and with sort_many on N threads, so the rows show sort_many's throughput against the thread count.
+//the baseline is per machine: --save-baseline writes this run to the baseline path
+//(stats/sort_bench_baseline.csv by default), later runs compare against it.
+//exit code 2 means at least one cell got slower than the baseline
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <random>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+#include "batch_sort.hpp"
+#include "bench_harness.hpp"
+#include "parallel_sort.hpp"
+#include "sort.hpp"
+#include "stable_sort.hpp"
+
+#ifndef SORT_BENCH_BASELINE
+#define SORT_BENCH_BASELINE "stats/sort_bench_baseline.csv"
+#endif
+
+namespace
+{
+    //the killer makes val::sort quadratic, bigger inputs would take minutes per repetition
+    constexpr size_t KILLER_MAX_SIZE = 1 << 15;
+    constexpr size_t INSERTION_MAX_SIZE = 1 << 12;
+    //cells faster than this are mostly timer noise and aren't compared with the baseline
+    constexpr double BASELINE_MIN_US = 20;
+
+    const std::vector<std::string> ENGINES = {"val_sort", "std_sort", "hoare", "lomuto", "branchless_lomuto",
+                                              "val_stable_sort", "std_stable_sort", "sample_sort",
+                                              "parallel_stable_sort", "insertion", "sort_each", "sort_many_1t",
+                                              "sort_many_2t", "sort_many_4t", "sort_many_8t"};
+    //engines that sort the input as many small arrays (see ArrayLengths) with their thread count,
+    //0 is a loop of val::sort
+    const std::map<std::string, unsigned, std::less<>> BATCH_ENGINES = {
+        {"sort_each", 0}, {"sort_many_1t", 1}, {"sort_many_2t", 2}, {"sort_many_4t", 4}, {"sort_many_8t", 8}};
+    const std::vector<std::string> DISTRIBUTIONS = {"random", "sorted", "reversed", "organ_pipe", "sawtooth",
+                                                    "few_unique", "nearly_sorted", "median3_killer"};
+    const std::vector<std::string> TYPES = {"i32", "i64", "f64", "str"};
+
+    struct Settings
+    {
+        std::vector<size_t> sizes = {1000, 100000, 1000000};
+        std::vector<std::string> types = TYPES;
+        std::vector<std::string> engines = ENGINES;
+        std::vector<std::string> dists = DISTRIBUTIONS;
+        val::bench::BenchmarkOptions options{1, 5};
+        std::string csv;
+        std::string json;
+        std::string baseline = SORT_BENCH_BASELINE;
+        bool saveBaseline = false;
+        double tolerance = 0.15;
+    };
+
+    struct Row
+    {
+        std::string engine;
+        std::string type;
+        std::string dist;
+        size_t size;
+        val::bench::BenchmarkResult result;
+    };
+
+    using CellKey = std::tuple<std::string, std::string, std::string, size_t>;
+
+    struct BaselineCell
+    {
+        double median;
+        double p90;
+    };
+
+    //McIlroy's adversary: every key starts as "gas" and only gets a value ("freezes") when the sort compares
+    //two gas keys, then it becomes the smallest one left. run against val::sort this produces an input on which
+    //its median of 3 pivot keeps splitting off a handful of elements
+    std::vector<uint64_t> MedianOfThreeKiller(size_t n)
+    {
+        const size_t gas = n;
+        std::vector<size_t> value(n, gas);
+        size_t solid = 0;
+        size_t candidate = 0;
+        auto comp = [&](size_t x, size_t y)
+        {
+            if (value[x] == gas && value[y] == gas)
+            {
+                if (x == candidate) value[x] = solid++;
+                else value[y] = solid++;
+            }
+            if (value[x] == gas) candidate = x;
+            else if (value[y] == gas) candidate = y;
+            return value[x] < value[y];
+        };
+
+        std::vector<size_t> idx(n);
+        std::iota(idx.begin(), idx.end(), 0);
+        val::HybridSortNoTailRecursion<val::SortTuning<int32_t>::partition>(
+            idx.data(), idx.data() + n, comp, val::SmallSortThreshold<int32_t*, std::less<int32_t>>());
+
+        std::vector<uint64_t> ranks(n);
+        for (size_t i = 0; i < n; i++) ranks[i] = value[i] == gas ? solid++ : value[i];
+        return ranks;
+    }
+
+    //distributions are generated as ranks and then mapped to keys with the same order
+    std::vector<uint64_t> MakeRanks(std::string_view dist, size_t n, std::mt19937_64& gen)
+    {
+        std::vector<uint64_t> r(n);
+        if (dist == "random")
+            for (auto& x : r) x = gen() % (uint64_t(1) << 31);
+        else if (dist == "sorted")
+            std::iota(r.begin(), r.end(), 0);
+        else if (dist == "reversed")
+            for (size_t i = 0; i < n; i++) r[i] = n - i;
+        else if (dist == "organ_pipe")
+            for (size_t i = 0; i < n; i++) r[i] = i < n / 2 ? i : n - i;
+        else if (dist == "sawtooth")
+            for (size_t i = 0; i < n; i++) r[i] = i % (n / 32 + 1);
+        else if (dist == "few_unique")
+            for (auto& x : r) x = gen() % 16;
+        else if (dist == "nearly_sorted")
+        {
+            std::iota(r.begin(), r.end(), 0);
+            std::uniform_int_distribution<size_t> pos(0, n - 1);
+            for (size_t i = 0; i < n / 100; i++) std::swap(r[pos(gen)], r[pos(gen)]);
+        }
+        else if (dist == "median3_killer")
+            r = MedianOfThreeKiller(n);
+        return r;
+    }
+
+    template <typename T>
+    T MakeKey(uint64_t rank)
+    {
+        if constexpr (std::is_same_v<T, std::string>)
+        {
+            std::string digits = std::to_string(rank);
+            return "key_" + std::string(12 - std::min<size_t>(12, digits.size()), '0') + digits;
+        }
+        else return static_cast<T>(rank);
+    }
+
+    template <typename T>
+    void RunEngine(std::string_view engine, T* first, T* last)
+    {
+        std::less<T> comp;
+        if (engine == "val_sort") val::sort(first, last, comp);
+        else if (engine == "std_sort") std::sort(first, last, comp);
+        else if (engine == "hoare") val::HybridSortNoTailRecursion<val::PartitionScheme::Hoare>(first, last, comp);
+        else if (engine == "lomuto") val::HybridSortNoTailRecursion<val::PartitionScheme::Lomuto>(first, last, comp);
+        else if (engine == "branchless_lomuto")
+            val::HybridSortNoTailRecursion<val::PartitionScheme::BranchlessLomuto>(first, last, comp);
+        else if (engine == "val_stable_sort") val::stable_sort(first, last, comp);
+        else if (engine == "std_stable_sort") std::stable_sort(first, last, comp);
+        else if (engine == "sample_sort") val::sample_sort(first, last, comp);
+        else if (engine == "parallel_stable_sort") val::parallel_stable_sort(first, last, comp);
+        else if (engine == "insertion") val::InsertionSort(first, last, comp);
+    }
+
+    //lengths that cut n elements into arrays like per-user lists: mostly under 40, every 4th up to 500
+    //and every 1000th up to 20000
+    std::vector<size_t> ArrayLengths(size_t n)
+    {
+        std::mt19937_64 gen(777);
+        std::vector<size_t> lengths;
+        for (size_t done = 0; done < n;)
+        {
+            uint64_t x = gen();
+            size_t length = x % 1000 == 0 ? x % 20000 : x % 4 == 0 ? x % 500 : x % 40;
+            length = std::min(length, n - done);
+            lengths.push_back(length);
+            done += length;
+        }
+        return lengths;
+    }
+
+    template <typename T>
+    std::vector<std::span<T>> SplitArrays(std::vector<T>& v, const std::vector<size_t>& lengths)
+    {
+        std::vector<std::span<T>> arrays;
+        T* first = v.data();
+        for (size_t length : lengths)
+        {
+            arrays.emplace_back(first, length);
+            first += length;
+        }
+        return arrays;
+    }
+
+    template <typename T>
+    void RunBatchEngine(unsigned threads, std::vector<std::span<T>>& arrays)
+    {
+        std::less<T> comp;
+        if (threads == 0)
+            for (auto array : arrays) val::sort(array.data(), array.data() + array.size(), comp);
+        else val::sort_many(arrays, comp, threads);
+    }
+
+    bool Skipped(std::string_view engine, std::string_view dist, size_t size)
+    {
+        return (engine == "insertion" && size > INSERTION_MAX_SIZE) || (dist == "median3_killer" && size > KILLER_MAX_SIZE);
+    }
+
+    template <typename T>
+    void RunType(const std::string& type, const Settings& settings, std::vector<Row>& rows)
+    {
+        std::mt19937_64 gen(12345);
+        for (size_t size : settings.sizes)
+        {
+            for (const auto& dist : settings.dists)
+            {
+                std::vector<uint64_t> ranks;
+                std::vector<T> input;
+                std::vector<T> work;
+                std::vector<size_t> lengths;
+                std::vector<std::span<T>> arrays;
+                for (const auto& engine : settings.engines)
+                {
+                    if (Skipped(engine, dist, size)) continue;
+                    if (input.empty())
+                    {
+                        ranks = MakeRanks(dist, size, gen);
+                        input.reserve(size);
+                        for (uint64_t r : ranks) input.push_back(MakeKey<T>(r));
+                        lengths = ArrayLengths(size);
+                    }
+
+                    auto batch = BATCH_ENGINES.find(engine);
+                    bool sorted;
+                    val::bench::BenchmarkResult result;
+                    if (batch != BATCH_ENGINES.end())
+                    {
+                        result = val::bench::Measure([&] { work = input; arrays = SplitArrays(work, lengths); },
+                                                     [&] { RunBatchEngine(batch->second, arrays); }, settings.options);
+                        sorted = std::ranges::all_of(arrays, [](auto array) { return std::ranges::is_sorted(array); });
+                    }
+                    else
+                    {
+                        result = val::bench::Measure([&] { work = input; },
+                                                     [&] { RunEngine<T>(engine, work.data(), work.data() + work.size()); },
+                                                     settings.options);
+                        sorted = std::is_sorted(work.begin(), work.end());
+                    }
+                    if (!sorted)
+                        std::cerr << engine << " " << type << " " << dist << " " << size << ": not sorted!\n";
+
+                    std::cout << std::left << std::setw(22) << engine << std::setw(5) << type << std::setw(16) << dist
+                              << std::right << std::setw(9) << size << std::setw(14) << std::fixed
+                              << std::setprecision(1) << result.median() << " us\n";
+                    rows.push_back({engine, type, dist, size, std::move(result)});
+                }
+            }
+        }
+    }
+
+    std::string CounterField(const val::bench::BenchmarkResult& result, size_t c)
+    {
+        auto value = result.counterMedian(static_cast<val::bench::Counter>(c));
+        if (!value) return "";
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(0) << *value;
+        return out.str();
+    }
+
+    void WriteCsv(std::ostream& out, const std::vector<Row>& rows)
+    {
+        out << "engine,type,distribution,size,median_us,p10_us,p90_us";
+        for (auto name : val::bench::COUNTER_NAMES) out << "," << name;
+        out << "\n" << std::fixed << std::setprecision(3);
+        for (const auto& row : rows)
+        {
+            out << row.engine << "," << row.type << "," << row.dist << "," << row.size << "," << row.result.median()
+                << "," << row.result.percentile(0.1) << "," << row.result.percentile(0.9);
+            for (size_t c = 0; c < val::bench::COUNTER_COUNT; c++) out << "," << CounterField(row.result, c);
+            out << "\n";
+        }
+    }
+
+    void WriteJson(std::ostream& out, const std::vector<Row>& rows)
+    {
+        out << "[\n" << std::fixed << std::setprecision(3);
+        for (size_t i = 0; i < rows.size(); i++)
+        {
+            const auto& row = rows[i];
+            out << "  {\"engine\": \"" << row.engine << "\", \"type\": \"" << row.type << "\", \"distribution\": \""
+                << row.dist << "\", \"size\": " << row.size << ", \"median_us\": " << row.result.median()
+                << ", \"p10_us\": " << row.result.percentile(0.1) << ", \"p90_us\": " << row.result.percentile(0.9);
+            for (size_t c = 0; c < val::bench::COUNTER_COUNT; c++)
+            {
+                std::string value = CounterField(row.result, c);
+                out << ", \"" << val::bench::COUNTER_NAMES[c] << "\": " << (value.empty() ? "null" : value);
+            }
+            out << "}" << (i + 1 < rows.size() ? "," : "") << "\n";
+        }
+        out << "]\n";
+    }
+
+    //median and p90 of every cell in a csv written by WriteCsv
+    std::map<CellKey, BaselineCell> ReadBaseline(std::istream& in)
+    {
+        std::map<CellKey, BaselineCell> cells;
+        std::string line;
+        std::getline(in, line); //header
+        while (std::getline(in, line))
+        {
+            std::istringstream fields(line);
+            std::string engine, type, dist, size, median, p10, p90;
+            if (std::getline(fields, engine, ',') && std::getline(fields, type, ',') &&
+                std::getline(fields, dist, ',') && std::getline(fields, size, ',') &&
+                std::getline(fields, median, ',') && std::getline(fields, p10, ',') && std::getline(fields, p90, ','))
+            {
+                cells[{engine, type, dist, std::stoull(size)}] = {std::stod(median), std::stod(p90)};
+            }
+        }
+        return cells;
+    }
+
+    //a cell regressed when its median is slower by more than tolerance and even its p10 is above the old p90,
+    //so a single noisy repetition on either side doesn't count
+    size_t CompareWithBaseline(const std::vector<Row>& rows, const std::map<CellKey, BaselineCell>& baseline,
+                               double tolerance)
+    {
+        size_t regressions = 0;
+        size_t compared = 0;
+        std::cout << std::fixed << std::setprecision(1);
+        for (const auto& row : rows)
+        {
+            auto it = baseline.find({row.engine, row.type, row.dist, row.size});
+            if (it == baseline.end() || it->second.median < BASELINE_MIN_US) continue;
+            compared++;
+            double now = row.result.median();
+            double change = now / it->second.median - 1;
+            if (change > tolerance && row.result.percentile(0.1) > it->second.p90)
+            {
+                regressions++;
+                std::cout << "REGRESSION " << row.engine << " " << row.type << " " << row.dist << " " << row.size
+                          << ": " << it->second.median << " us -> " << now << " us (+" << change * 100 << "%)\n";
+            }
+        }
+        std::cout << compared << " cells compared with the baseline, " << regressions << " regressions\n";
+        return regressions;
+    }
+
+    std::vector<std::string> SplitList(std::string_view list)
+    {
+        std::vector<std::string> items;
+        std::istringstream in{std::string(list)};
+        std::string item;
+        while (std::getline(in, item, ','))
+            if (!item.empty()) items.push_back(item);
+        return items;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Settings settings;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        auto next = [&]() -> std::string_view
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << arg << " needs a value" << std::endl;
+                std::exit(1);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--quick")
+        {
+            settings.sizes = {1000, 30000};
+            settings.options = {1, 3};
+        }
+        else if (arg == "--sizes")
+        {
+            settings.sizes.clear();
+            for (const auto& s : SplitList(next())) settings.sizes.push_back(std::stoull(s));
+        }
+        else if (arg == "--types") settings.types = SplitList(next());
+        else if (arg == "--engines") settings.engines = SplitList(next());
+        else if (arg == "--dists") settings.dists = SplitList(next());
+        else if (arg == "--reps") settings.options.repetitions = std::stoi(std::string(next()));
+        else if (arg == "--warmups") settings.options.warmups = std::stoi(std::string(next()));
+        else if (arg == "--csv") settings.csv = next();
+        else if (arg == "--json") settings.json = next();
+        else if (arg == "--baseline") settings.baseline = next();
+        else if (arg == "--no-baseline") settings.baseline.clear();
+        else if (arg == "--save-baseline") settings.saveBaseline = true;
+        else if (arg == "--tolerance") settings.tolerance = std::stod(std::string(next()));
+        else
+        {
+            std::cerr << "unknown argument " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<Row> rows;
+    for (const auto& type : settings.types)
+    {
+        if (type == "i32") RunType<int32_t>(type, settings, rows);
+        else if (type == "i64") RunType<int64_t>(type, settings, rows);
+        else if (type == "f64") RunType<double>(type, settings, rows);
+        else if (type == "str") RunType<std::string>(type, settings, rows);
+        else std::cerr << "unknown type " << type << ", skipped" << std::endl;
+    }
+
+    if (!settings.csv.empty())
+    {
+        std::ofstream out(settings.csv);
+        WriteCsv(out, rows);
+        std::cout << "written " << settings.csv << std::endl;
+    }
+    if (!settings.json.empty())
+    {
+        std::ofstream out(settings.json);
+        WriteJson(out, rows);
+        std::cout << "written " << settings.json << std::endl;
+    }
+
+    if (settings.saveBaseline)
+    {
+        if (settings.baseline.empty())
+        {
+            std::cerr << "--save-baseline needs a baseline path" << std::endl;
+            return 1;
+        }
+        std::ofstream out(settings.baseline);
+        if (!out)
+        {
+            std::cerr << "can't write " << settings.baseline << std::endl;
+            return 1;
+        }
+        WriteCsv(out, rows);
+        std::cout << "baseline saved to " << settings.baseline << std::endl;
+    }
+    else if (!settings.baseline.empty())
+    {
+        std::ifstream in(settings.baseline);
+        if (!in)
+        {
+            std::cout << "no baseline at " << settings.baseline << ", nothing compared" << std::endl;
+            return 0;
+        }
+        if (CompareWithBaseline(rows, ReadBaseline(in), settings.tolerance) > 0) return 2;
+    }
+    return 0;
+}
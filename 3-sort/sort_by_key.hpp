@@ -0,0 +1,125 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <vector>
+#include "permutation.hpp"
+#include "sort.hpp"
+#include "stable_sort.hpp"
+
+namespace val
+{
+    //keys that RadixKey can turn into an order preserving unsigned integer
+    template <typename Key>
+    inline constexpr bool RadixSortableKey =
+        (std::is_integral_v<Key> && !std::is_same_v<Key, bool>) ||
+        std::is_same_v<Key, float> || std::is_same_v<Key, double>;
+
+    //unsigned integer with the same order as key (negative floats have all bits flipped, the rest only the sign).
+    //-0.0 maps to the same value as 0.0, they are equal keys and keep their order
+    template <typename Key>
+    auto RadixKey(Key key)
+    {
+        if constexpr (std::is_floating_point_v<Key>)
+        {
+            using U = std::conditional_t<sizeof(Key) == 4, uint32_t, uint64_t>;
+            constexpr U SIGN = U(1) << (sizeof(U) * 8 - 1);
+            if (key == Key(0)) key = Key(0);
+            U bits = std::bit_cast<U>(key);
+            return (bits & SIGN) ? U(~bits) : U(bits | SIGN);
+        }
+        else
+        {
+            using U = std::make_unsigned_t<Key>;
+            U bits = static_cast<U>(key);
+            if constexpr (std::is_signed_v<Key>) bits ^= U(1) << (sizeof(U) * 8 - 1);
+            return bits;
+        }
+    }
+
+    //stable LSD radix sort on entry.key, one byte per pass,
+    //all histograms come from a single read and passes where every key has the same byte are skipped
+    template <typename Entry>
+    void RadixSortEntries(std::vector<Entry>& entries)
+    {
+        using U = decltype(Entry::key);
+        constexpr size_t PASSES = sizeof(U);
+        std::vector<size_t> counts(PASSES * 256, 0);
+        for (const auto& e : entries)
+            for (size_t pass = 0; pass < PASSES; pass++)
+                counts[pass * 256 + ((e.key >> (pass * 8)) & 0xFF)]++;
+
+        std::vector<Entry> buffer(entries.size());
+        for (size_t pass = 0; pass < PASSES; pass++)
+        {
+            size_t* count = counts.data() + pass * 256;
+            size_t shift = pass * 8;
+            if (count[(entries[0].key >> shift) & 0xFF] == entries.size()) continue;
+
+            size_t offset = 0;
+            for (size_t digit = 0; digit < 256; digit++)
+            {
+                size_t c = count[digit];
+                count[digit] = offset;
+                offset += c;
+            }
+            for (const auto& e : entries)
+                buffer[count[(e.key >> shift) & 0xFF]++] = e;
+            entries.swap(buffer);
+        }
+    }
+
+    template <typename Index, std::random_access_iterator It, typename KeyFn, typename Compare>
+    void SortByKeyImpl(It first, size_t len, KeyFn& keyFn, Compare comp)
+    {
+        using Key = std::remove_cvref_t<std::invoke_result_t<KeyFn&, std::iter_reference_t<It>>>;
+        std::vector<Index> perm(len);
+
+        if constexpr (RadixSortableKey<Key> && IsPlainLess<Compare, Key>)
+        {
+            using U = decltype(RadixKey(Key{}));
+            struct Entry
+            {
+                U key;
+                Index index;
+            };
+            std::vector<Entry> entries(len);
+            for (size_t i = 0; i < len; i++)
+                entries[i] = {RadixKey(std::invoke(keyFn, first[i])), static_cast<Index>(i)};
+            RadixSortEntries(entries);
+            for (size_t i = 0; i < len; i++) perm[i] = entries[i].index;
+        }
+        else
+        {
+            struct Entry
+            {
+                Key key;
+                Index index;
+            };
+            std::vector<Entry> entries;
+            entries.reserve(len);
+            for (size_t i = 0; i < len; i++)
+                entries.push_back({std::invoke(keyFn, first[i]), static_cast<Index>(i)});
+            stable_sort(entries.data(), entries.data() + len,
+                        [&](const Entry& a, const Entry& b) { return comp(a.key, b.key); });
+            for (size_t i = 0; i < len; i++) perm[i] = entries[i].index;
+        }
+
+        ApplyPermutation(first, perm);
+    }
+
+    //decorate-sort-undecorate: keyFn is called once per element, the (key, index) pairs are sorted
+    //(radix sort for arithmetic keys with plain <) and the elements are then permuted in place.
+    //stable, elements with equal keys keep their order
+    template <std::random_access_iterator It, typename KeyFn, typename Compare = std::ranges::less>
+    void sort_by_key(It first, It last, KeyFn keyFn, Compare comp = {})
+    {
+        size_t len = last - first;
+        if (len < 2) return;
+        if (len <= std::numeric_limits<uint32_t>::max()) SortByKeyImpl<uint32_t>(first, len, keyFn, comp);
+        else SortByKeyImpl<size_t>(first, len, keyFn, comp);
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+
+namespace val
+{
+    //instrumentation policies for the engines in sort.hpp, passed as the last argument
+    //NoInstrumentation is the default: every hook is empty, so an uninstrumented sort compiles to the same code.
+    //enabled means comparisons are counted too, policies that only need the other hooks leave it false
+    struct NoInstrumentation
+    {
+        static constexpr bool enabled = false;
+
+        void compare() {}
+        void swap() {}
+        void move(size_t = 1) {}
+        void partition(size_t, size_t) {}
+        //n more elements are in their final position
+        void sorted(size_t) {}
+        void enter() {}
+        void leave() {}
+    };
+
+    //counts what the engines do; comparisons are counted by the comparator val::sort wraps around comp
+    struct SortCounters
+    {
+        static constexpr bool enabled = true;
+
+        size_t comparisons = 0;
+        size_t swaps = 0;
+        size_t moves = 0;
+        size_t partitions = 0;
+        //larger side / partitioned elements: 0.5 is a perfect split, close to 1 is the quadratic case
+        double imbalanceSum = 0;
+        double worstImbalance = 0;
+        size_t depth = 0;
+        size_t maxDepth = 0;
+
+        void compare() { comparisons++; }
+        void swap() { swaps++; }
+        void move(size_t n = 1) { moves += n; }
+        void sorted(size_t) {}
+
+        void partition(size_t left, size_t right)
+        {
+            if (left + right == 0) return;
+            double imbalance = static_cast<double>(std::max(left, right)) / static_cast<double>(left + right);
+            partitions++;
+            imbalanceSum += imbalance;
+            worstImbalance = std::max(worstImbalance, imbalance);
+        }
+
+        void enter() { maxDepth = std::max(maxDepth, ++depth); }
+        void leave() { depth--; }
+
+        double meanImbalance() const { return partitions ? imbalanceSum / partitions : 0; }
+    };
+
+    //one recursion level of an engine, leaves it on every return path
+    template <typename Stats>
+    class RecursionScope
+    {
+    public:
+        explicit RecursionScope(Stats& stats) : m_stats(stats) { m_stats.enter(); }
+        ~RecursionScope() { m_stats.leave(); }
+        RecursionScope(const RecursionScope&) = delete;
+        RecursionScope& operator=(const RecursionScope&) = delete;
+
+    private:
+        Stats& m_stats;
+    };
+
+    template <std::random_access_iterator It, typename Stats>
+    void CountedSwap(It a, It b, Stats& stats)
+    {
+        stats.swap();
+        std::iter_swap(a, b);
+    }
+
+    //comp as it is when nothing is counted (so fast paths still recognize it), otherwise a counting wrapper
+    template <typename Compare, typename Stats>
+    auto InstrumentedCompare(Compare comp, Stats& stats)
+    {
+        if constexpr (!std::remove_cvref_t<Stats>::enabled)
+        {
+            return comp;
+        }
+        else
+        {
+            return [comp, &stats](const auto& a, const auto& b) mutable
+            {
+                stats.compare();
+                return comp(a, b);
+            };
+        }
+    }
+}
@@ -0,0 +1,192 @@
+//calibrates val::sort for this machine: for every key type tries the candidate insertion thresholds
+//with every partition scheme and writes sort_tuning.hpp, which sort.hpp picks up on the next build
+//usage: sort_tune [output header] [--quick]
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "sort.hpp"
+
+#ifndef SORT_TUNING_OUTPUT
+#define SORT_TUNING_OUTPUT "sort_tuning.hpp"
+#endif
+
+namespace
+{
+    constexpr size_t THRESHOLDS[] = {8, 16, 24, 32, 48, 64, 96, 128, 200, 256};
+
+    struct Settings
+    {
+        std::vector<size_t> sizes = {1000, 10000, 100000, 1000000};
+        int runs = 7;
+    };
+
+    struct Result
+    {
+        size_t threshold;
+        val::PartitionScheme scheme;
+        double time_us;
+    };
+
+    template <typename T>
+    T MakeKey(std::mt19937_64& gen, uint64_t range)
+    {
+        uint64_t x = gen() % range;
+        if constexpr (std::is_same_v<T, std::string>) return "key_" + std::to_string(x);
+        else return static_cast<T>(x);
+    }
+
+    //random keys and keys with only a few distinct values, the two cases where the threshold matters most
+    template <typename T>
+    std::vector<std::vector<T>> MakeInputs(const Settings& settings)
+    {
+        std::mt19937_64 gen(12345);
+        std::vector<std::vector<T>> inputs;
+        for (size_t size : settings.sizes)
+        {
+            for (uint64_t range : {uint64_t(1) << 40, uint64_t(100)})
+            {
+                std::vector<T> v(size);
+                for (auto& x : v) x = MakeKey<T>(gen, range);
+                inputs.push_back(std::move(v));
+            }
+        }
+        return inputs;
+    }
+
+    //val::sort hands strings under plain std::less to StringSort, the tuning only applies to custom orders,
+    //so strings are measured under one that the dispatch doesn't recognize
+    template <typename T>
+    struct TuneCompare
+    {
+        using type = std::less<T>;
+    };
+
+    template <>
+    struct TuneCompare<std::string>
+    {
+        struct type
+        {
+            bool operator()(const std::string& a, const std::string& b) const { return a < b; }
+        };
+    };
+
+    //median of settings.runs over all inputs, in microseconds
+    template <val::PartitionScheme Scheme, typename T>
+    double Measure(const std::vector<std::vector<T>>& inputs, size_t threshold, const Settings& settings)
+    {
+        std::vector<double> times;
+        for (int run = 0; run < settings.runs; run++)
+        {
+            double total = 0;
+            for (const auto& input : inputs)
+            {
+                auto v = input;
+                auto start = std::chrono::steady_clock::now();
+                val::HybridSortNoTailRecursion<Scheme>(v.data(), v.data() + v.size(), typename TuneCompare<T>::type(), threshold);
+                auto end = std::chrono::steady_clock::now();
+                total += std::chrono::duration<double, std::micro>(end - start).count();
+                if (!std::is_sorted(v.begin(), v.end())) std::cerr << "not sorted!\n";
+            }
+            times.push_back(total);
+        }
+        std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+        return times[times.size() / 2];
+    }
+
+    template <typename T>
+    Result Tune(std::string_view name, const Settings& settings)
+    {
+        auto inputs = MakeInputs<T>(settings);
+        Result best{val::INSERTION_THRESHOLD, val::PartitionScheme::Hoare, 1e300};
+        std::cout << name << ":\n";
+        for (size_t threshold : THRESHOLDS)
+        {
+            double hoare = Measure<val::PartitionScheme::Hoare>(inputs, threshold, settings);
+            double lomuto = Measure<val::PartitionScheme::Lomuto>(inputs, threshold, settings);
+            double branchless = Measure<val::PartitionScheme::BranchlessLomuto>(inputs, threshold, settings);
+            std::cout << "  threshold " << threshold << ": hoare " << hoare << " us, lomuto " << lomuto
+                      << " us, branchless lomuto " << branchless << " us\n";
+            if (hoare < best.time_us) best = {threshold, val::PartitionScheme::Hoare, hoare};
+            if (lomuto < best.time_us) best = {threshold, val::PartitionScheme::Lomuto, lomuto};
+            if (branchless < best.time_us) best = {threshold, val::PartitionScheme::BranchlessLomuto, branchless};
+        }
+        return best;
+    }
+
+    std::string_view SchemeName(val::PartitionScheme scheme)
+    {
+        switch (scheme)
+        {
+        case val::PartitionScheme::Hoare: return "Hoare";
+        case val::PartitionScheme::Lomuto: return "Lomuto";
+        case val::PartitionScheme::BranchlessLomuto: return "BranchlessLomuto";
+        }
+        return "Hoare";
+    }
+
+    void WriteSpecialization(std::ostream& out, std::string_view type, const Result& r)
+    {
+        out << "    template <>\n"
+            << "    struct SortTuning<" << type << ">\n"
+            << "    {\n"
+            << "        static constexpr bool tuned = true;\n"
+            << "        static constexpr size_t insertionThreshold = " << r.threshold << ";\n"
+            << "        static constexpr PartitionScheme partition = PartitionScheme::" << SchemeName(r.scheme) << ";\n"
+            << "    };\n";
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string output = SORT_TUNING_OUTPUT;
+    Settings settings;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        if (arg == "--quick")
+        {
+            settings.sizes = {1000, 100000};
+            settings.runs = 3;
+        }
+        else output = arg;
+    }
+
+    Result i32 = Tune<int32_t>("int32_t", settings);
+    Result i64 = Tune<int64_t>("int64_t", settings);
+    Result f64 = Tune<double>("double", settings);
+    Result str = Tune<std::string>("std::string", settings);
+
+    std::ofstream out(output);
+    if (!out)
+    {
+        std::cerr << "can't write " << output << std::endl;
+        return 1;
+    }
+    std::time_t now = std::time(nullptr);
+    out << "//generated by sort_tune on " << std::put_time(std::localtime(&now), "%Y-%m-%d %H:%M") << ", don't edit\n"
+        << "//rerun sort_tune on the target machine to recalibrate\n"
+        << "#pragma once\n\n"
+        << "#include <cstdint>\n"
+        << "#include <string>\n\n"
+        << "namespace val\n"
+        << "{\n";
+    WriteSpecialization(out, "int32_t", i32);
+    out << "\n";
+    WriteSpecialization(out, "int64_t", i64);
+    out << "\n";
+    WriteSpecialization(out, "double", f64);
+    out << "\n";
+    WriteSpecialization(out, "std::string", str);
+    out << "}\n";
+
+    std::cout << "written " << output << std::endl;
+    return 0;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include "sort.hpp"
+
+namespace val
+{
+    namespace unique
+    {
+        //drops the defaults of sort_unique into sort_reduce_by_key: one of the equal elements is kept, which one
+        //is unspecified since the sort isn't stable
+        struct KeepOne
+        {
+            template <typename T, typename U>
+            void operator()(T&, U&&) const
+            {
+            }
+        };
+
+        //a part of the range still to be sorted, or one that is already in place (the pivot and its equal keys)
+        template <typename It>
+        struct Segment
+        {
+            It first;
+            It last;
+            bool sorted;
+        };
+
+        //quicksort that finishes its parts from left to right: the left side of every partition is sorted first,
+        //so each finished leaf lies right after what was already written and is compacted into [first, out)
+        //while it's still in cache. reduce(kept, std::move(next)) folds every element equal to the last written one
+        //into it, returns out
+        template <PartitionScheme Scheme, std::random_access_iterator It, typename Compare, typename Reduce>
+        It SortReduce(It first, It last, Compare comp, Reduce& reduce, size_t threshold)
+        {
+            It begin = first;
+            It out = first;
+            auto emit = [&](It from, It to)
+            {
+                for (It p = from; p != to; ++p)
+                {
+                    if (out != begin && !comp(out[-1], *p))
+                    {
+                        reduce(out[-1], std::move(*p));
+                    }
+                    else
+                    {
+                        if (out != p) *out = std::move(*p);
+                        ++out;
+                    }
+                }
+            };
+
+            std::vector<Segment<It>> pending;
+            pending.push_back({first, last, false});
+            while (!pending.empty())
+            {
+                auto [from, to, sorted] = pending.back();
+                pending.pop_back();
+                if (!sorted)
+                {
+                    while (static_cast<size_t>(to - from) > threshold)
+                    {
+                        auto [leftEnd, rightBegin] = PartitionStep<Scheme>(from, to, comp);
+                        if (rightBegin != to) pending.push_back({rightBegin, to, false});
+                        if (leftEnd != rightBegin) pending.push_back({leftEnd, rightBegin, true});
+                        to = leftEnd;
+                    }
+                    if (to - from > 1) SmallSort(from, to, comp);
+                }
+                emit(from, to);
+            }
+            return out;
+        }
+    } //namespace unique
+
+    //sorts [first, last) by keyFn and collapses every run of equal keys into its first element:
+    //reduce(kept, std::move(other)) is called for the others, e.g. to add up their values.
+    //the reduction happens as the sort finishes each part, so there is no second pass over the whole range.
+    //returns the new end, the elements after it are valid but unspecified. not stable, the order in which
+    //equal elements are folded is unspecified, so reduce should be associative and commutative
+    template <std::random_access_iterator It, typename KeyFn, typename Reduce, typename Compare = std::ranges::less>
+    It sort_reduce_by_key(It first, It last, KeyFn keyFn, Reduce reduce, Compare comp = {})
+    {
+        if (last - first < 2) return last;
+        if constexpr (std::contiguous_iterator<It> && !std::is_pointer_v<It>)
+        {
+            //pointers get the SIMD leaves of SmallSort
+            auto* data = std::to_address(first);
+            return first + (sort_reduce_by_key(data, data + (last - first), keyFn, reduce, comp) - data);
+        }
+        else
+        {
+            //lomuto keeps the pivot's equal keys together, and its branchless kernel is the faster one anyway
+            auto projected = ProjectedCompare(comp, keyFn);
+            return unique::SortReduce<PartitionScheme::BranchlessLomuto>(first, last, projected, reduce,
+                                                                         SmallSortThreshold<It, decltype(projected)>());
+        }
+    }
+
+    //sort followed by std::unique in one pass, returns the new end. any one of equal elements survives
+    template <std::random_access_iterator It, typename Compare = std::ranges::less>
+    It sort_unique(It first, It last, Compare comp = {})
+    {
+        return sort_reduce_by_key(first, last, std::identity{}, unique::KeepOne{}, comp);
+    }
+
+    //both erase the tail the vector doesn't need anymore
+    template <typename T, typename Compare = std::ranges::less>
+    void sort_unique(std::vector<T>& v, Compare comp = {})
+    {
+        v.erase(sort_unique(v.begin(), v.end(), comp), v.end());
+    }
+
+    template <typename T, typename KeyFn, typename Reduce, typename Compare = std::ranges::less>
+    void sort_reduce_by_key(std::vector<T>& v, KeyFn keyFn, Reduce reduce, Compare comp = {})
+    {
+        v.erase(sort_reduce_by_key(v.begin(), v.end(), keyFn, reduce, comp), v.end());
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <ranges>
+#include <vector>
+#include "stable_sort.hpp"
+
+namespace val
+{
+    //[first, middle) is sorted, [middle, last) is a new batch in any order:
+    //only the batch is sorted, then it's merged in by StableSorter::merge, which gallops over the parts that are
+    //already in place and buffers the smaller side. O(n + k log k) instead of sorting all n + k again.
+    //stable: old elements stay before equal new ones, the batch keeps its own order of equal elements
+    template <typename T, typename Compare>
+    void merge_into_sorted(T* first, T* middle, T* last, Compare comp,
+                           size_t maxBuffer = std::numeric_limits<size_t>::max())
+    {
+        StableSorter<T, Compare> sorter(comp, maxBuffer);
+        sorter.sort(middle, last);
+        sorter.merge(first, middle, last);
+    }
+
+    //appends batch to the sorted vector and merges it in
+    template <typename T, std::ranges::input_range Batch, typename Compare = std::ranges::less>
+    void merge_into_sorted(std::vector<T>& sorted, Batch&& batch, Compare comp = {})
+    {
+        size_t middle = sorted.size();
+        sorted.insert(sorted.end(), std::ranges::begin(batch), std::ranges::end(batch));
+        merge_into_sorted(sorted.data(), sorted.data() + middle, sorted.data() + sorted.size(), comp);
+    }
+
+    //sorts a range that is usually a sorted array with a few elements appended:
+    //the sorted prefix is found with one scan and only the rest is sorted and merged in
+    template <typename T, typename Compare>
+    void sort_append(T* first, T* last, Compare comp)
+    {
+        T* middle = std::is_sorted_until(first, last, comp);
+        if (middle == last) return;
+        merge_into_sorted(first, middle, last, comp);
+    }
+}
@@ -0,0 +1,361 @@
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <new>
+#include <vector>
+
+namespace val
+{
+    //runs shorter than this are extended with binary insertion sort
+    inline constexpr size_t STABLE_MIN_MERGE = 32;
+    //consecutive wins before a merge switches to galloping
+    inline constexpr size_t MIN_GALLOP = 7;
+
+    //first position in [first, last) where pred is false, pred has to be true on a prefix
+    //probes 1, 2, 4... elements from the left so a boundary close to first costs O(log distance)
+    template <typename T, typename Pred>
+    T* GallopFromLeft(T* first, T* last, Pred pred)
+    {
+        size_t len = last - first;
+        size_t prev = 0;
+        size_t ofs = 1;
+        while (ofs <= len && pred(first[ofs - 1]))
+        {
+            prev = ofs;
+            ofs *= 2;
+        }
+        return std::partition_point(first + prev, first + std::min(ofs, len), pred);
+    }
+
+    //same as GallopFromLeft but probes from the right end
+    template <typename T, typename Pred>
+    T* GallopFromRight(T* first, T* last, Pred pred)
+    {
+        size_t len = last - first;
+        size_t prev = 0;
+        size_t ofs = 1;
+        while (ofs <= len && !pred(last[-static_cast<ptrdiff_t>(ofs)]))
+        {
+            prev = ofs;
+            ofs *= 2;
+        }
+        size_t lo = ofs > len ? 0 : len - ofs + 1;
+        return std::partition_point(first + lo, first + (len - prev), pred);
+    }
+
+    //[first, sortedEnd) is sorted, inserts the rest one by one after equal elements
+    template <typename T, typename Compare>
+    void BinaryInsertionSort(T* first, T* sortedEnd, T* last, Compare comp)
+    {
+        if (sortedEnd == first) ++sortedEnd;
+        for (; sortedEnd < last; ++sortedEnd)
+        {
+            T val = std::move(*sortedEnd);
+            T* pos = std::upper_bound(first, sortedEnd, val, comp);
+            std::move_backward(pos, sortedEnd, sortedEnd + 1);
+            *pos = std::move(val);
+        }
+    }
+
+    //returns the end of the natural run starting at first, strictly descending runs are reversed
+    //(strictly, so that reversing can't reorder equal elements)
+    template <typename T, typename Compare>
+    T* FindRun(T* first, T* last, Compare comp)
+    {
+        T* runEnd = first + 1;
+        if (runEnd >= last) return last;
+        if (comp(*runEnd, *first))
+        {
+            while (++runEnd != last && comp(*runEnd, *(runEnd - 1)));
+            std::reverse(first, runEnd);
+        }
+        else
+        {
+            while (++runEnd != last && !comp(*runEnd, *(runEnd - 1)));
+        }
+        return runEnd;
+    }
+
+    //minimal run length so that n / minRun is a power of two or slightly less (same as in timsort)
+    inline size_t MinRunLength(size_t n)
+    {
+        size_t r = 0;
+        while (n >= STABLE_MIN_MERGE)
+        {
+            r |= n & 1;
+            n >>= 1;
+        }
+        return n + r;
+    }
+
+    //stable merge of [first, middle) and [middle, last) without extra memory, O(n log n) moves
+    template <typename T, typename Compare>
+    void MergeInPlace(T* first, T* middle, T* last, Compare comp)
+    {
+        if (first == middle || middle == last) return;
+        if (last - first == 2)
+        {
+            if (comp(*middle, *first)) std::swap(*first, *middle);
+            return;
+        }
+        T* cut1;
+        T* cut2;
+        if (middle - first > last - middle)
+        {
+            cut1 = first + (middle - first) / 2;
+            cut2 = std::lower_bound(middle, last, *cut1, comp);
+        }
+        else
+        {
+            cut2 = middle + (last - middle) / 2;
+            cut1 = std::upper_bound(first, middle, *cut2, comp);
+        }
+        T* newMiddle = std::rotate(cut1, middle, cut2);
+        MergeInPlace(first, cut1, newMiddle, comp);
+        MergeInPlace(newMiddle, cut2, last, comp);
+    }
+
+    //natural merge sort with galloping (timsort), keeps one scratch buffer for all merges
+    template <typename T, typename Compare>
+    class StableSorter
+    {
+    public:
+        StableSorter(Compare comp, size_t maxBuffer)
+            : m_comp(comp)
+            , m_maxBuffer(maxBuffer)
+        {
+        }
+
+        void sort(T* first, T* last)
+        {
+            size_t len = last - first;
+            if (len < 2) return;
+            if (len < STABLE_MIN_MERGE)
+            {
+                BinaryInsertionSort(first, FindRun(first, last, m_comp), last, m_comp);
+                return;
+            }
+
+            size_t minRun = MinRunLength(len);
+            m_runs.clear();
+            T* cur = first;
+            while (cur != last)
+            {
+                T* runEnd = FindRun(cur, last, m_comp);
+                if (static_cast<size_t>(runEnd - cur) < minRun)
+                {
+                    T* forcedEnd = cur + std::min(minRun, static_cast<size_t>(last - cur));
+                    BinaryInsertionSort(cur, runEnd, forcedEnd, m_comp);
+                    runEnd = forcedEnd;
+                }
+                m_runs.push_back({cur, static_cast<size_t>(runEnd - cur)});
+                mergeCollapse();
+                cur = runEnd;
+            }
+            while (m_runs.size() > 1)
+            {
+                size_t n = m_runs.size() - 2;
+                if (n > 0 && m_runs[n - 1].len < m_runs[n + 1].len) --n;
+                mergeAt(n);
+            }
+        }
+
+        //stable merge of two adjacent sorted ranges, used by the other merge based algorithms too
+        void merge(T* first, T* middle, T* last)
+        {
+            //elements of a that are <= b[0] and elements of b that are >= a.back() are already in place
+            first = GallopFromLeft(first, middle, [&](const T& x) { return !m_comp(*middle, x); });
+            if (first == middle) return;
+            last = GallopFromRight(middle, last, [&](const T& x) { return m_comp(x, *(middle - 1)); });
+            if (middle == last) return;
+
+            size_t lenA = middle - first;
+            size_t lenB = last - middle;
+            if (!reserveBuffer(std::min(lenA, lenB)))
+            {
+                MergeInPlace(first, middle, last, m_comp);
+                return;
+            }
+            if (lenA <= lenB) mergeLo(first, middle, last);
+            else mergeHi(first, middle, last);
+        }
+
+    private:
+        struct Run
+        {
+            T* first;
+            size_t len;
+        };
+
+        //keeps run lengths decreasing faster than fibonacci, so the stack stays O(log n)
+        void mergeCollapse()
+        {
+            while (m_runs.size() > 1)
+            {
+                size_t n = m_runs.size() - 2;
+                if ((n > 0 && m_runs[n - 1].len <= m_runs[n].len + m_runs[n + 1].len) ||
+                    (n > 1 && m_runs[n - 2].len <= m_runs[n - 1].len + m_runs[n].len))
+                {
+                    if (m_runs[n - 1].len < m_runs[n + 1].len) --n;
+                    mergeAt(n);
+                }
+                else if (m_runs[n].len <= m_runs[n + 1].len)
+                {
+                    mergeAt(n);
+                }
+                else break;
+            }
+        }
+
+        void mergeAt(size_t i)
+        {
+            T* first = m_runs[i].first;
+            T* middle = first + m_runs[i].len;
+            T* last = middle + m_runs[i + 1].len;
+            m_runs[i].len += m_runs[i + 1].len;
+            m_runs.erase(m_runs.begin() + i + 1);
+            merge(first, middle, last);
+        }
+
+        bool reserveBuffer(size_t n)
+        {
+            if (n > m_maxBuffer) return false;
+            if (m_buffer.capacity() >= n) return true;
+            try
+            {
+                m_buffer.reserve(n);
+            }
+            catch (const std::bad_alloc&)
+            {
+                return false;
+            }
+            return true;
+        }
+
+        //left run goes to the buffer and the merge runs forward
+        void mergeLo(T* first, T* middle, T* last)
+        {
+            m_buffer.assign(std::make_move_iterator(first), std::make_move_iterator(middle));
+            T* pa = m_buffer.data();
+            T* aEnd = pa + m_buffer.size();
+            T* pb = middle;
+            T* dest = first;
+
+            while (pa != aEnd && pb != last)
+            {
+                size_t winsA = 0;
+                size_t winsB = 0;
+                while (pa != aEnd && pb != last)
+                {
+                    if (m_comp(*pb, *pa))
+                    {
+                        *dest++ = std::move(*pb++);
+                        winsA = 0;
+                        if (++winsB >= m_minGallop) break;
+                    }
+                    else
+                    {
+                        *dest++ = std::move(*pa++);
+                        winsB = 0;
+                        if (++winsA >= m_minGallop) break;
+                    }
+                }
+
+                while (pa != aEnd && pb != last)
+                {
+                    T* runA = GallopFromLeft(pa, aEnd, [&](const T& x) { return !m_comp(*pb, x); });
+                    size_t countA = runA - pa;
+                    dest = std::move(pa, runA, dest);
+                    pa = runA;
+                    if (pa == aEnd) break;
+
+                    T* runB = GallopFromLeft(pb, last, [&](const T& x) { return m_comp(x, *pa); });
+                    size_t countB = runB - pb;
+                    dest = std::move(pb, runB, dest);
+                    pb = runB;
+
+                    if (countA < MIN_GALLOP && countB < MIN_GALLOP)
+                    {
+                        ++m_minGallop;
+                        break;
+                    }
+                    if (m_minGallop > 1) --m_minGallop;
+                }
+            }
+            //whatever is left of b is already in place
+            std::move(pa, aEnd, dest);
+            m_buffer.clear();
+        }
+
+        //right run goes to the buffer and the merge runs backward
+        void mergeHi(T* first, T* middle, T* last)
+        {
+            m_buffer.assign(std::make_move_iterator(middle), std::make_move_iterator(last));
+            T* bBegin = m_buffer.data();
+            T* pb = bBegin + m_buffer.size();
+            T* pa = middle;
+            T* dest = last;
+
+            while (pa != first && pb != bBegin)
+            {
+                size_t winsA = 0;
+                size_t winsB = 0;
+                while (pa != first && pb != bBegin)
+                {
+                    if (m_comp(*(pb - 1), *(pa - 1)))
+                    {
+                        *--dest = std::move(*--pa);
+                        winsB = 0;
+                        if (++winsA >= m_minGallop) break;
+                    }
+                    else
+                    {
+                        *--dest = std::move(*--pb);
+                        winsA = 0;
+                        if (++winsB >= m_minGallop) break;
+                    }
+                }
+
+                while (pa != first && pb != bBegin)
+                {
+                    T* runA = GallopFromRight(first, pa, [&](const T& x) { return !m_comp(*(pb - 1), x); });
+                    size_t countA = pa - runA;
+                    dest = std::move_backward(runA, pa, dest);
+                    pa = runA;
+                    if (pa == first) break;
+
+                    T* runB = GallopFromRight(bBegin, pb, [&](const T& x) { return m_comp(x, *(pa - 1)); });
+                    size_t countB = pb - runB;
+                    dest = std::move_backward(runB, pb, dest);
+                    pb = runB;
+
+                    if (countA < MIN_GALLOP && countB < MIN_GALLOP)
+                    {
+                        ++m_minGallop;
+                        break;
+                    }
+                    if (m_minGallop > 1) --m_minGallop;
+                }
+            }
+            //whatever is left of a is already in place
+            std::move(bBegin, pb, first);
+            m_buffer.clear();
+        }
+
+        Compare m_comp;
+        size_t m_maxBuffer;
+        size_t m_minGallop = MIN_GALLOP;
+        std::vector<T> m_buffer;
+        std::vector<Run> m_runs;
+    };
+
+    //stable, O(n) on presorted input, maxBuffer limits the scratch buffer (in elements),
+    //merges that don't fit (or fail to allocate) are done in place
+    template <typename T, typename Compare>
+    void stable_sort(T* first, T* last, Compare comp, size_t maxBuffer = std::numeric_limits<size_t>::max())
+    {
+        StableSorter<T, Compare>(comp, maxBuffer).sort(first, last);
+    }
+}
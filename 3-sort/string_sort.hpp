@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "permutation.hpp"
+#include "sort.hpp"
+
+namespace val
+{
+    //string partitions this small are finished with insertion sort
+    inline constexpr size_t STRING_INSERTION_THRESHOLD = 16;
+
+    namespace strsort
+    {
+        //8 bytes of the string starting at the current depth are cached next to the pointer,
+        //so most comparisons don't touch the string itself
+        struct Entry
+        {
+            uint64_t prefix;
+            const char* data;
+            size_t size;
+            size_t index;
+        };
+
+        //big endian so that integer order is the same as unsigned char order, missing bytes are 0
+        inline uint64_t LoadPrefix(const char* data, size_t size, size_t depth)
+        {
+            if (size <= depth) return 0;
+            size_t n = size - depth;
+            if (n >= 8)
+            {
+                uint64_t x;
+                std::memcpy(&x, data + depth, 8);
+                if constexpr (std::endian::native == std::endian::little)
+                {
+#if defined(__GNUC__) || defined(__clang__)
+                    x = __builtin_bswap64(x);
+#else
+                    uint64_t swapped = 0;
+                    for (int k = 0; k < 8; k++) swapped |= ((x >> (8 * k)) & 0xFF) << (56 - 8 * k);
+                    x = swapped;
+#endif
+                }
+                return x;
+            }
+            uint64_t x = 0;
+            for (size_t k = 0; k < n; k++)
+                x |= uint64_t(static_cast<unsigned char>(data[depth + k])) << (56 - 8 * k);
+            return x;
+        }
+
+        //full comparison of two entries that are known to be equal before depth
+        inline bool LessFrom(const Entry& a, const Entry& b, size_t depth)
+        {
+            if (a.prefix != b.prefix) return a.prefix < b.prefix;
+            return std::string_view(a.data + depth, a.size - depth) < std::string_view(b.data + depth, b.size - depth);
+        }
+
+        inline void InsertionSortFrom(Entry* first, Entry* last, size_t depth)
+        {
+            for (Entry* i = first + 1; i < last; ++i)
+            {
+                Entry val = *i;
+                Entry* j = i;
+                for (; j > first && LessFrom(val, *(j - 1), depth); --j)
+                    *j = *(j - 1);
+                *j = val;
+            }
+        }
+
+        //partitions a part may take at one depth before it is heap sorted instead
+        inline int PartitionBudget(size_t n)
+        {
+            return 2 * std::bit_width(n);
+        }
+
+        //full comparison heap sort, for parts whose pivots keep coming out lopsided
+        inline void HeapSortFrom(Entry* first, Entry* last, size_t depth)
+        {
+            auto less = [depth](const Entry& x, const Entry& y) { return LessFrom(x, y, depth); };
+            std::make_heap(first, last, less);
+            std::sort_heap(first, last, less);
+        }
+
+        //a part of equal prefixes waiting for the next 8 bytes
+        struct EqualPart
+        {
+            Entry* first;
+            Entry* last;
+            size_t depth;
+        };
+
+        //multikey quicksort on 8 byte chunks: 3-way partition by the cached prefix, the less and greater parts
+        //stay at this depth, the equal part moves on to the next 8 bytes, so a shared prefix is never read again.
+        //only the smaller of less / greater is sorted recursively, the larger one by the loop and the equal parts
+        //from a worklist, so the stack stays O(log n). after budget partitions the rest is heap sorted
+        inline void MultikeyQuickSort(Entry* first, Entry* last, size_t depth, int budget)
+        {
+            std::vector<EqualPart> pending;
+            for (;;)
+            {
+                while (last - first > static_cast<ptrdiff_t>(STRING_INSERTION_THRESHOLD))
+                {
+                    if (budget-- == 0)
+                    {
+                        HeapSortFrom(first, last, depth);
+                        first = last;
+                        break;
+                    }
+
+                    uint64_t a = first->prefix;
+                    uint64_t b = first[(last - first) / 2].prefix;
+                    uint64_t c = (last - 1)->prefix;
+                    uint64_t pivot = std::max(std::min(a, b), std::min(std::max(a, b), c));
+
+                    Entry* lt = first;
+                    Entry* i = first;
+                    Entry* gt = last;
+                    while (i < gt)
+                    {
+                        if (i->prefix < pivot) std::swap(*lt++, *i++);
+                        else if (i->prefix > pivot) std::swap(*i, *--gt);
+                        else ++i;
+                    }
+
+                    //strings that end within this chunk are prefixes of the rest, among themselves only the
+                    //number of trailing zero bytes differs
+                    Entry* rest = std::partition(lt, gt, [depth](const Entry& e) { return e.size <= depth + 8; });
+                    val::sort(lt, rest, [](const Entry& x, const Entry& y) { return x.size < y.size; });
+                    if (gt - rest > 1) pending.push_back({rest, gt, depth + 8});
+
+                    if (lt - first < last - gt)
+                    {
+                        MultikeyQuickSort(first, lt, depth, budget);
+                        first = gt;
+                    }
+                    else
+                    {
+                        MultikeyQuickSort(gt, last, depth, budget);
+                        last = lt;
+                    }
+                }
+                InsertionSortFrom(first, last, depth);
+
+                if (pending.empty()) return;
+                EqualPart part = pending.back();
+                pending.pop_back();
+                first = part.first;
+                last = part.last;
+                depth = part.depth;
+                budget = PartitionBudget(last - first);
+                for (Entry* e = first; e < last; ++e) e->prefix = LoadPrefix(e->data, e->size, depth);
+            }
+        }
+    } //namespace strsort
+
+    //sorts std::string / std::string_view in byte order, picked by val::sort for plain <
+    template <typename T>
+    void StringSort(T* first, T* last)
+    {
+        static_assert(IsStringKey<T>);
+        size_t len = last - first;
+        if (len < 2) return;
+
+        std::vector<strsort::Entry> entries(len);
+        for (size_t i = 0; i < len; i++)
+        {
+            std::string_view s = first[i];
+            entries[i] = {strsort::LoadPrefix(s.data(), s.size(), 0), s.data(), s.size(), i};
+        }
+        strsort::MultikeyQuickSort(entries.data(), entries.data() + len, 0, strsort::PartitionBudget(len));
+
+        std::vector<size_t> perm(len);
+        for (size_t i = 0; i < len; i++) perm[i] = entries[i].index;
+        ApplyPermutation(first, perm);
+    }
+}
@@ -1,9 +1,12 @@
 #include "dice.hpp"
+#include "dice_batch.hpp"
 
 #include <string_view>
 #include <ranges>
 #include <algorithm>
+#include <climits>
 #include <iostream>
+#include <thread>
 
 namespace DiceRandom
 {
@@ -115,4 +118,63 @@ namespace DiceRandom
     {
         return getDiceGroupRollCount(parseDiceString(input), times);
     }
+
+    std::map<int, int> getDiceGroupRollCountParallel(const std::vector<DiceInfo>& diceGroups, int times,
+                                                     uint64_t seed, unsigned threads)
+    {
+        if (diceGroups.empty() || times <= 0) return {};
+
+        //every possible value gets a slot, a dense histogram is much cheaper to count into than the map
+        int minValue = INT_MAX;
+        int maxValue = INT_MIN;
+        for (const auto& g : diceGroups)
+        {
+            int count = std::max(g.count, 0);
+            minValue = std::min(minValue, count + g.mod);
+            maxValue = std::max(maxValue, count * g.sides + g.mod);
+        }
+
+        size_t blocks = (static_cast<size_t>(times) + ROLLS_PER_STREAM - 1) / ROLLS_PER_STREAM;
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = static_cast<unsigned>(std::min<size_t>(threads, blocks));
+
+        std::vector<std::vector<int64_t>> histograms(threads, std::vector<int64_t>(maxValue - minValue + 1, 0));
+        {
+            std::vector<std::jthread> workers;
+            for (unsigned t = 0; t < threads; t++)
+            {
+                workers.emplace_back([&, t]
+                {
+                    auto& histogram = histograms[t];
+                    for (size_t block = t; block < blocks; block += threads)
+                    {
+                        SplitMix64 gen(seed);
+                        gen.discard(block * SPLITMIX_STREAM_LENGTH);
+                        BatchDiceRoller roller(gen);
+                        int from = static_cast<int>(block * ROLLS_PER_STREAM);
+                        int to = std::min(times, from + ROLLS_PER_STREAM);
+                        for (const auto& g : diceGroups)
+                        {
+                            size_t offset = std::max(g.count, 0) + g.mod - minValue;
+                            roller.addRollSums(std::span(histogram).subspan(offset), g.sides, g.count, to - from);
+                        }
+                    }
+                });
+            }
+        }
+
+        std::map<int, int> result{};
+        for (int value = minValue; value <= maxValue; value++)
+        {
+            int64_t count = 0;
+            for (const auto& histogram : histograms) count += histogram[value - minValue];
+            if (count > 0) result.emplace_hint(result.end(), value, static_cast<int>(count));
+        }
+        return result;
+    }
+
+    std::map<int, int> getDiceGroupRollCountParallel(std::string_view input, int times, uint64_t seed, unsigned threads)
+    {
+        return getDiceGroupRollCountParallel(parseDiceString(input), times, seed, threads);
+    }
 } //namespace
\ No newline at end of file
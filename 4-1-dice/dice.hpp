@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstdint>
 #include <map>
 #include <random>
+#include "random_engines.hpp"
 
 struct DiceInfo
 {
@@ -12,16 +14,24 @@ struct DiceInfo
     bool operator==(const DiceInfo& other) const = default;
 };
 
-class RandomGenerator
+//Engine is any std engine or one from random_engines.hpp (Xoshiro256StarStar, Pcg64, Philox4x32, SplitMix64)
+template <std::uniform_random_bit_generator Engine>
+class BasicRandomGenerator
 {
 public:
-    static std::mt19937& getGenerator()
+    //one engine per thread, so rolling from several threads isn't a data race
+    static Engine& getGenerator()
     {
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
+        thread_local Engine gen(randomSeed());
         return gen;
     }
 
+    //restarts this thread's engine from a fixed seed, for reproducible rolls
+    static void seed(uint64_t seed)
+    {
+        getGenerator() = Engine(seed);
+    }
+
     static int getRandomDieRoll(int sides)
     {
         std::uniform_int_distribution<> dist_i(1, sides);
@@ -45,8 +55,18 @@ public:
         }
         return acc;
     }
+
+private:
+    static uint64_t randomSeed()
+    {
+        std::random_device rd;
+        return (static_cast<uint64_t>(rd()) << 32) | rd();
+    }
 };
 
+//xoshiro256** instead of std::mt19937: 32 bytes of state instead of 2.5KB and several times the draws per second
+using RandomGenerator = BasicRandomGenerator<Xoshiro256StarStar>;
+
 namespace DiceRandom
 {
     DiceInfo parseDiceGroupToken(std::string_view token);
@@ -59,5 +79,18 @@ namespace DiceRandom
 
     std::map<int,int> getDiceGroupRollCount(const std::vector<DiceInfo>& diceGroups, int times = 1);
     std::map<int,int> getDiceGroupRollCount(std::string_view input, int times = 1);
+
+    //rolls per stream of the parallel simulation, the streams are SPLITMIX_STREAM_LENGTH draws apart in one SplitMix64
+    //and seed the lanes of a BatchDiceRoller
+    inline constexpr int ROLLS_PER_STREAM = 1 << 12;
+    inline constexpr uint64_t SPLITMIX_STREAM_LENGTH = uint64_t(1) << 40;
+
+    //getDiceGroupRollCount on threads (0 = one per core): the rolls are cut into blocks of ROLLS_PER_STREAM,
+    //each with its own stream of the seed, and counted into per thread histograms that are added up at the end.
+    //the result depends only on the seed, not on the number of threads
+    std::map<int,int> getDiceGroupRollCountParallel(const std::vector<DiceInfo>& diceGroups, int times,
+                                                    uint64_t seed, unsigned threads = 0);
+    std::map<int,int> getDiceGroupRollCountParallel(std::string_view input, int times,
+                                                    uint64_t seed, unsigned threads = 0);
 }
 
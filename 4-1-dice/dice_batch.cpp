@@ -0,0 +1,214 @@
+#include "dice_batch.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <numeric>
+
+//the avx2 kernel is only compiled for x86 with GCC/Clang and enabled per function with the target attribute
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define DICE_HAS_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    //rolls buffered at a time by rollSum and addRollSums
+    constexpr size_t ROLL_BUFFER = 4096;
+
+    //2^32 mod sides: low products below it are rejected so every roll has the same number of 32 bit inputs
+    uint32_t rejectionThreshold(uint32_t sides)
+    {
+        return (0u - sides) % sides;
+    }
+
+    //one step of every lane, out gets STEP rolls: lane l fills out[2l] from the low half of its output
+    //and out[2l + 1] from the high half. rejected rolls are written as 0, returns how many
+    size_t stepScalar(uint64_t* state, int* out, uint32_t sides, uint32_t threshold)
+    {
+        constexpr size_t L = BatchDiceRoller::LANES;
+        uint64_t* s0 = state;
+        uint64_t* s1 = state + L;
+        uint64_t* s2 = state + 2 * L;
+        uint64_t* s3 = state + 3 * L;
+        size_t rejected = 0;
+        for (size_t l = 0; l < L; l++)
+        {
+            uint64_t x = std::rotl(s1[l] * 5, 7) * 9;
+            uint64_t t = s1[l] << 17;
+            s2[l] ^= s0[l];
+            s3[l] ^= s1[l];
+            s1[l] ^= s2[l];
+            s0[l] ^= s3[l];
+            s2[l] ^= t;
+            s3[l] = std::rotl(s3[l], 45);
+
+            for (int half = 0; half < 2; half++)
+            {
+                uint64_t m = static_cast<uint64_t>(static_cast<uint32_t>(x >> (32 * half))) * sides;
+                bool reject = static_cast<uint32_t>(m) < threshold;
+                rejected += reject;
+                out[2 * l + half] = reject ? 0 : static_cast<int>(m >> 32) + 1;
+            }
+        }
+        return rejected;
+    }
+
+#ifdef DICE_HAS_AVX2
+    bool avx2Available()
+    {
+        static const bool avx2 = __builtin_cpu_supports("avx2");
+        return avx2;
+    }
+
+    __attribute__((target("avx2"))) inline __m256i rotl64(__m256i x, int k)
+    {
+        return _mm256_or_si256(_mm256_slli_epi64(x, k), _mm256_srli_epi64(x, 64 - k));
+    }
+
+    //steps times stepScalar, 4 lanes per register
+    __attribute__((target("avx2"))) size_t stepsAvx2(uint64_t* state, int* out, size_t steps, uint32_t sides,
+                                                   uint32_t threshold)
+    {
+        constexpr size_t L = BatchDiceRoller::LANES;
+        static_assert(L == 8, "two registers of 4 lanes");
+        __m256i s[4][2];
+        for (int w = 0; w < 4; w++)
+            for (int r = 0; r < 2; r++)
+                s[w][r] = _mm256_load_si256(reinterpret_cast<const __m256i*>(state + w * L + 4 * r));
+
+        const __m256i sidesVec = _mm256_set1_epi64x(sides);
+        const __m256i one = _mm256_set1_epi32(1);
+        const __m256i flip = _mm256_set1_epi32(INT32_MIN);
+        //unsigned low < threshold as a signed compare with the sign bits flipped
+        const __m256i thresholdVec = _mm256_set1_epi32(static_cast<int>(threshold ^ 0x80000000u));
+        size_t rejected = 0;
+        for (size_t step = 0; step < steps; step++)
+        {
+            for (int r = 0; r < 2; r++)
+            {
+                __m256i s1 = s[1][r];
+                __m256i x = rotl64(_mm256_add_epi64(_mm256_slli_epi64(s1, 2), s1), 7);
+                x = _mm256_add_epi64(_mm256_slli_epi64(x, 3), x);
+                __m256i t = _mm256_slli_epi64(s1, 17);
+                s[2][r] = _mm256_xor_si256(s[2][r], s[0][r]);
+                s[3][r] = _mm256_xor_si256(s[3][r], s1);
+                s[1][r] = _mm256_xor_si256(s1, s[2][r]);
+                s[0][r] = _mm256_xor_si256(s[0][r], s[3][r]);
+                s[2][r] = _mm256_xor_si256(s[2][r], t);
+                s[3][r] = rotl64(s[3][r], 45);
+
+                //products of the low and high halves, every 64 bit lane holds roll - 1 on top and the rest below
+                __m256i lo = _mm256_mul_epu32(x, sidesVec);
+                __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), sidesVec);
+                __m256i rolls = _mm256_blend_epi32(_mm256_srli_epi64(lo, 32), hi, 0b10101010);
+                __m256i rest = _mm256_blend_epi32(lo, _mm256_slli_epi64(hi, 32), 0b10101010);
+                __m256i reject = _mm256_cmpgt_epi32(thresholdVec, _mm256_xor_si256(rest, flip));
+                rolls = _mm256_andnot_si256(reject, _mm256_add_epi32(rolls, one));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + step * BatchDiceRoller::STEP + 8 * r), rolls);
+                rejected += std::popcount(static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(reject))));
+            }
+        }
+
+        for (int w = 0; w < 4; w++)
+            for (int r = 0; r < 2; r++)
+                _mm256_store_si256(reinterpret_cast<__m256i*>(state + w * L + 4 * r), s[w][r]);
+        return rejected;
+    }
+#endif
+
+    size_t steps(uint64_t* state, int* out, size_t steps, uint32_t sides, uint32_t threshold)
+    {
+#ifdef DICE_HAS_AVX2
+        if (avx2Available()) return stepsAvx2(state, out, steps, sides, threshold);
+#endif
+        size_t rejected = 0;
+        for (size_t step = 0; step < steps; step++)
+            rejected += stepScalar(state, out + step * BatchDiceRoller::STEP, sides, threshold);
+        return rejected;
+    }
+}
+
+BatchDiceRoller::BatchDiceRoller(uint64_t seed)
+{
+    SplitMix64 seeder(seed);
+    for (auto& word : m_state) word = seeder();
+    m_fallback.seed(seeder());
+}
+
+BatchDiceRoller::BatchDiceRoller(SplitMix64& seeder)
+{
+    for (auto& word : m_state) word = seeder();
+    m_fallback.seed(seeder());
+}
+
+void BatchDiceRoller::fillRolls(std::span<int> out, int sides)
+{
+    uint32_t s = static_cast<uint32_t>(sides);
+    uint32_t threshold = rejectionThreshold(s);
+    size_t full = out.size() / STEP;
+    size_t rejected = steps(m_state.data(), out.data(), full, s, threshold);
+
+    size_t done = full * STEP;
+    if (done < out.size())
+    {
+        std::array<int, STEP> tail;
+        rejected += steps(m_state.data(), tail.data(), 1, s, threshold);
+        std::copy_n(tail.begin(), out.size() - done, out.begin() + done);
+    }
+
+    //about threshold / 2^32 of the values, none when sides is a power of 2
+    if (rejected > 0)
+    {
+        for (int& roll : out)
+        {
+            while (roll == 0)
+            {
+                uint64_t m = static_cast<uint64_t>(static_cast<uint32_t>(m_fallback())) * s;
+                if (static_cast<uint32_t>(m) >= threshold) roll = static_cast<int>(m >> 32) + 1;
+            }
+        }
+    }
+}
+
+int64_t BatchDiceRoller::rollSum(int sides, int64_t count)
+{
+    std::array<int, ROLL_BUFFER> buffer;
+    int64_t acc = 0;
+    while (count > 0)
+    {
+        size_t n = static_cast<size_t>(std::min<int64_t>(count, ROLL_BUFFER));
+        fillRolls(std::span(buffer.data(), n), sides);
+        acc += std::accumulate(buffer.begin(), buffer.begin() + n, int64_t(0));
+        count -= n;
+    }
+    return acc;
+}
+
+void BatchDiceRoller::addRollSums(std::span<int64_t> histogram, int sides, int count, int times)
+{
+    if (count <= 0)
+    {
+        histogram[0] += times;
+        return;
+    }
+    if (static_cast<size_t>(count) > ROLL_BUFFER / 2)
+    {
+        for (int i = 0; i < times; i++) histogram[rollSum(sides, count) - count]++;
+        return;
+    }
+
+    std::array<int, ROLL_BUFFER> buffer;
+    int perFill = static_cast<int>(ROLL_BUFFER / count);
+    for (int done = 0; done < times; done += perFill)
+    {
+        int rolls = std::min(perFill, times - done);
+        fillRolls(std::span(buffer.data(), static_cast<size_t>(rolls) * count), sides);
+        const int* roll = buffer.data();
+        for (int i = 0; i < rolls; i++, roll += count)
+        {
+            int sum = 0;
+            for (int d = 0; d < count; d++) sum += roll[d];
+            histogram[sum - count]++;
+        }
+    }
+}
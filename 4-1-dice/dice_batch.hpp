@@ -0,0 +1,38 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include "random_engines.hpp"
+
+//rolls dice in bulk: xoshiro256** runs on LANES independent lanes stored lane by lane, so one step is a few
+//vector instructions (AVX2 where the cpu has it), and every 64 bit output gives two rolls by Lemire's
+//multiply-shift. the rare rejected values are redrawn afterwards, the rolls stay unbiased.
+//the output for a seed is the same with and without AVX2
+class BatchDiceRoller
+{
+public:
+    static constexpr size_t LANES = 8;
+    //rolls produced by one step of all lanes
+    static constexpr size_t STEP = 2 * LANES;
+
+    explicit BatchDiceRoller(uint64_t seed);
+    //the lanes take their state from seeder, e.g. a SplitMix64 moved to its own stream
+    explicit BatchDiceRoller(SplitMix64& seeder);
+
+    //unbiased rolls in [1, sides]
+    void fillRolls(std::span<int> out, int sides);
+
+    //sum of count rolls
+    int64_t rollSum(int sides, int64_t count);
+
+    //rolls count dice times times, histogram[sum - count] is incremented for every sum,
+    //so it needs count * (sides - 1) + 1 entries
+    void addRollSums(std::span<int64_t> histogram, int sides, int count, int times);
+
+private:
+    //m_state[word * LANES + lane]
+    alignas(32) std::array<uint64_t, 4 * LANES> m_state;
+    //redraws rejected values
+    Xoshiro256StarStar m_fallback;
+};
@@ -0,0 +1,137 @@
+#include "dice_distribution.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <complex>
+#include <numbers>
+
+namespace
+{
+    using Complex = std::complex<long double>;
+
+    //below this many terms in the shorter operand the direct product is faster than the FFT (and exact)
+    constexpr size_t FFT_THRESHOLD = 64;
+
+    //in place iterative radix 2 FFT, a.size() is a power of 2
+    void fft(std::vector<Complex>& a, bool invert)
+    {
+        size_t n = a.size();
+        for (size_t i = 1, j = 0; i < n; i++)
+        {
+            size_t bit = n >> 1;
+            for (; j & bit; bit >>= 1) j ^= bit;
+            j ^= bit;
+            if (i < j) std::swap(a[i], a[j]);
+        }
+
+        //every twiddle is computed directly, multiplying them up loses precision on long transforms
+        std::vector<Complex> roots(n / 2);
+        for (size_t k = 0; k < n / 2; k++)
+        {
+            long double angle = 2 * std::numbers::pi_v<long double> * k / n;
+            roots[k] = std::polar(1.0L, invert ? -angle : angle);
+        }
+
+        for (size_t len = 2; len <= n; len <<= 1)
+        {
+            size_t step = n / len;
+            for (size_t i = 0; i < n; i += len)
+            {
+                for (size_t k = 0; k < len / 2; k++)
+                {
+                    Complex u = a[i + k];
+                    Complex v = a[i + k + len / 2] * roots[k * step];
+                    a[i + k] = u + v;
+                    a[i + k + len / 2] = u - v;
+                }
+            }
+        }
+
+        if (invert)
+            for (auto& x : a) x /= static_cast<long double>(n);
+    }
+
+    std::vector<long double> convolve(const std::vector<long double>& a, const std::vector<long double>& b)
+    {
+        size_t size = a.size() + b.size() - 1;
+        std::vector<long double> result(size, 0.0L);
+        if (std::min(a.size(), b.size()) <= FFT_THRESHOLD)
+        {
+            for (size_t i = 0; i < a.size(); i++)
+                for (size_t j = 0; j < b.size(); j++)
+                    result[i + j] += a[i] * b[j];
+            return result;
+        }
+
+        size_t n = std::bit_ceil(size);
+        std::vector<Complex> fa(a.begin(), a.end());
+        fa.resize(n);
+        fft(fa, false);
+        if (&a == &b)
+        {
+            for (auto& x : fa) x *= x;
+        }
+        else
+        {
+            std::vector<Complex> fb(b.begin(), b.end());
+            fb.resize(n);
+            fft(fb, false);
+            for (size_t i = 0; i < n; i++) fa[i] *= fb[i];
+        }
+        fft(fa, true);
+        //rounding leaves tiny negative values where the probability is close to 0
+        for (size_t i = 0; i < size; i++) result[i] = std::max(fa[i].real(), 0.0L);
+        return result;
+    }
+}
+
+namespace DiceDistribution
+{
+    std::vector<long double> getSumProbabilities(int sides, int count)
+    {
+        //rollDice sums nothing for count <= 0
+        if (count <= 0) return {1.0L};
+
+        //exponentiation by squaring: log2(count) products instead of count
+        std::vector<long double> die(sides, 1.0L / sides);
+        std::vector<long double> result{1.0L};
+        for (;;)
+        {
+            if (count & 1) result = convolve(result, die);
+            count >>= 1;
+            if (count == 0) break;
+            die = convolve(die, die);
+        }
+        return result;
+    }
+
+    std::map<int, long double> getDiceDistribution(const DiceInfo& dice)
+    {
+        std::map<int, long double> result;
+        int minValue = std::max(dice.count, 0) + dice.mod;
+        auto probabilities = getSumProbabilities(dice.sides, dice.count);
+        for (size_t i = 0; i < probabilities.size(); i++)
+        {
+            result.emplace_hint(result.end(), minValue + static_cast<int>(i), probabilities[i]);
+        }
+        return result;
+    }
+
+    std::map<int, long double> getDiceGroupDistribution(const std::vector<DiceInfo>& diceGroups)
+    {
+        std::map<int, long double> result;
+        for (const auto& g : diceGroups)
+        {
+            for (auto [value, p] : getDiceDistribution(g))
+            {
+                result[value] += p / diceGroups.size();
+            }
+        }
+        return result;
+    }
+
+    std::map<int, long double> getDiceGroupDistribution(std::string_view input)
+    {
+        return getDiceGroupDistribution(DiceRandom::parseDiceString(input));
+    }
+} //namespace
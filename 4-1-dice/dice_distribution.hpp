@@ -0,0 +1,21 @@
+#pragma once
+
+#include <map>
+#include <string_view>
+#include <vector>
+#include "dice.hpp"
+
+//exact probabilities instead of sampled counts, computed by convolving the per-die distributions
+namespace DiceDistribution
+{
+    //probabilities of the sums of count dice with the given sides, index 0 is the smallest sum (count)
+    std::vector<long double> getSumProbabilities(int sides, int count);
+
+    //distribution of rollDice(dice)
+    std::map<int, long double> getDiceDistribution(const DiceInfo& dice);
+
+    //what getDiceGroupRollCount converges to: every group adds one value per roll,
+    //so this is the average of the groups' distributions
+    std::map<int, long double> getDiceGroupDistribution(const std::vector<DiceInfo>& diceGroups);
+    std::map<int, long double> getDiceGroupDistribution(std::string_view input);
+}
@@ -1,4 +1,10 @@
 #include "dice.hpp"
+#include "dice_distribution.hpp"
+#include "dice_batch.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numeric>
 #include <iostream>
 #include <fstream>
 #include <ranges>
@@ -35,6 +41,211 @@ TEST(StringParsing, EmptyString)
     EXPECT_EQ(DiceRandom::parseDiceString(input), expected);
 }
 
+TEST(Distribution, TwoDice)
+{
+    auto distribution = DiceDistribution::getDiceDistribution({2, 6, 1});
+    ASSERT_EQ(distribution.size(), 11);
+    EXPECT_EQ(distribution.begin()->first, 3);
+    EXPECT_EQ(distribution.rbegin()->first, 13);
+    for (int sum = 2; sum <= 12; sum++)
+    {
+        EXPECT_NEAR(distribution[sum + 1], (6 - std::abs(sum - 7)) / 36.0L, 1e-18L);
+    }
+}
+
+TEST(Distribution, ManyDiceMatchDirectConvolution)
+{
+    //the FFT path against adding one die at a time
+    const int sides = 6;
+    const int count = 300;
+    std::vector<long double> expected{1.0L};
+    for (int i = 0; i < count; i++)
+    {
+        std::vector<long double> next(expected.size() + sides - 1, 0.0L);
+        for (size_t j = 0; j < expected.size(); j++)
+            for (int face = 0; face < sides; face++) next[j + face] += expected[j] / sides;
+        expected = next;
+    }
+
+    auto probabilities = DiceDistribution::getSumProbabilities(sides, count);
+    ASSERT_EQ(probabilities.size(), expected.size());
+    long double total = 0;
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        EXPECT_NEAR(probabilities[i], expected[i], 1e-15L);
+        total += probabilities[i];
+    }
+    EXPECT_NEAR(total, 1.0L, 1e-15L);
+}
+
+TEST(Distribution, GroupsAreAveraged)
+{
+    auto distribution = DiceDistribution::getDiceGroupDistribution("d4+1, d2-1, 0d6+2");
+    std::map<int, long double> expected{{0, 1 / 6.0L}, {1, 1 / 6.0L}, {2, 1 / 12.0L + 1 / 3.0L},
+                                        {3, 1 / 12.0L}, {4, 1 / 12.0L}, {5, 1 / 12.0L}};
+    ASSERT_EQ(distribution.size(), expected.size());
+    for (auto [value, p] : expected)
+    {
+        EXPECT_NEAR(distribution[value], p, 1e-18L) << value;
+    }
+    EXPECT_TRUE(DiceDistribution::getDiceGroupDistribution("").empty());
+}
+
+TEST(ParallelSimulation, ReproducibleForSeed)
+{
+    auto groups = DiceRandom::parseDiceString("3d6, 2d10+1");
+    auto single = DiceRandom::getDiceGroupRollCountParallel(groups, 50000, 42, 1);
+    EXPECT_EQ(DiceRandom::getDiceGroupRollCountParallel(groups, 50000, 42, 4), single);
+    EXPECT_EQ(DiceRandom::getDiceGroupRollCountParallel(groups, 50000, 42, 7), single);
+    EXPECT_NE(DiceRandom::getDiceGroupRollCountParallel(groups, 50000, 43, 4), single);
+
+    int total = 0;
+    for (auto [value, count] : single) total += count;
+    EXPECT_EQ(total, 100000);
+    EXPECT_TRUE(DiceRandom::getDiceGroupRollCountParallel(groups, 0, 42).empty());
+}
+
+TEST(ParallelSimulation, ConvergesToExactDistribution)
+{
+    const int times = 1 << 20;
+    auto counts = DiceRandom::getDiceGroupRollCountParallel("3d6", times, 7);
+    for (auto [value, p] : DiceDistribution::getDiceGroupDistribution("3d6"))
+    {
+        //well within 5 standard deviations of the binomial count
+        double expected = static_cast<double>(p) * times;
+        EXPECT_NEAR(counts[value], expected, 5 * std::sqrt(expected) + 1) << value;
+    }
+}
+
+static_assert(std::uniform_random_bit_generator<SplitMix64>);
+static_assert(std::uniform_random_bit_generator<Xoshiro256StarStar>);
+static_assert(std::uniform_random_bit_generator<Pcg64>);
+static_assert(std::uniform_random_bit_generator<Philox4x32>);
+
+TEST(RandomEngines, KnownAnswers)
+{
+    //Random123 and pcg-c reference outputs
+    EXPECT_EQ(Philox4x32::generate({0, 0}, {0, 0}), (Philox4x32::Block{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}));
+    EXPECT_EQ(Philox4x32::generate({~0ull, ~0ull}, {~0u, ~0u}),
+              (Philox4x32::Block{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}));
+    Pcg64 pcg(42, 54);
+    EXPECT_EQ(pcg(), 0x86b1da1d72062b68);
+    EXPECT_EQ(pcg(), 0x1304aa46c9853d39);
+    EXPECT_EQ(pcg(), 0xa3670e9e0dd50358);
+}
+
+template <typename Engine>
+void expectDiscardMatchesDraws(uint64_t seed)
+{
+    for (uint64_t n : {0, 1, 2, 3, 1000, 1001})
+    {
+        Engine stepped(seed);
+        Engine jumped(seed);
+        for (uint64_t i = 0; i < n; i++) stepped();
+        jumped.discard(n);
+        EXPECT_EQ(stepped, jumped) << n;
+        EXPECT_EQ(stepped(), jumped()) << n;
+    }
+    EXPECT_NE(Engine(seed)(), Engine(seed + 1)());
+}
+
+TEST(RandomEngines, DiscardMatchesDraws)
+{
+    expectDiscardMatchesDraws<SplitMix64>(5);
+    expectDiscardMatchesDraws<Xoshiro256StarStar>(5);
+    expectDiscardMatchesDraws<Pcg64>(5);
+    expectDiscardMatchesDraws<Philox4x32>(5);
+
+    //a jump lands somewhere else than a few draws ahead
+    Xoshiro256StarStar a(1);
+    Xoshiro256StarStar b(1);
+    b.jump();
+    EXPECT_NE(a, b);
+}
+
+TEST(RandomEngines, SeededGeneratorRepeats)
+{
+    auto roll = []
+    {
+        BasicRandomGenerator<Philox4x32>::seed(11);
+        return BasicRandomGenerator<Philox4x32>::getRandomDiceRolls(20, 100);
+    };
+    auto first = roll();
+    EXPECT_EQ(roll(), first);
+    EXPECT_TRUE(std::ranges::all_of(first, [](int r) { return r >= 1 && r <= 20; }));
+
+    RandomGenerator::seed(3);
+    int sum = RandomGenerator::getRandomDiceRollSum(6, 3);
+    RandomGenerator::seed(3);
+    EXPECT_EQ(RandomGenerator::getRandomDiceRollSum(6, 3), sum);
+}
+
+TEST(BatchRolls, MatchScalarXoshiroLanes)
+{
+    //lane l starts from words l, 8 + l, 16 + l, 24 + l of the seeder and gives rolls 2l (low half) and 2l + 1
+    SplitMix64 seeder(99);
+    std::array<std::array<uint64_t, 4>, BatchDiceRoller::LANES> lanes;
+    for (size_t w = 0; w < 4; w++)
+        for (auto& lane : lanes) lane[w] = seeder();
+
+    BatchDiceRoller roller(99);
+    std::vector<int> rolls(3 * BatchDiceRoller::STEP);
+    roller.fillRolls(rolls, 6);
+    for (size_t step = 0; step < 3; step++)
+    {
+        for (size_t l = 0; l < BatchDiceRoller::LANES; l++)
+        {
+            auto& s = lanes[l];
+            uint64_t x = std::rotl(s[1] * 5, 7) * 9;
+            uint64_t t = s[1] << 17;
+            s[2] ^= s[0];
+            s[3] ^= s[1];
+            s[1] ^= s[2];
+            s[0] ^= s[3];
+            s[2] ^= t;
+            s[3] = std::rotl(s[3], 45);
+            EXPECT_EQ(rolls[step * BatchDiceRoller::STEP + 2 * l], ((x & 0xffffffff) * 6 >> 32) + 1);
+            EXPECT_EQ(rolls[step * BatchDiceRoller::STEP + 2 * l + 1], ((x >> 32) * 6 >> 32) + 1);
+        }
+    }
+}
+
+TEST(BatchRolls, UnbiasedInRange)
+{
+    BatchDiceRoller roller(5);
+    for (int sides : {1, 2, 6, 7, 20, 1000000000})
+    {
+        //odd length so the partial last step is covered too
+        std::vector<int> rolls(600001);
+        roller.fillRolls(rolls, sides);
+        EXPECT_TRUE(std::ranges::all_of(rolls, [&](int r) { return r >= 1 && r <= sides; })) << sides;
+        double mean = std::accumulate(rolls.begin(), rolls.end(), 0.0) / rolls.size();
+        double sd = (sides - 1) / std::sqrt(12.0 * rolls.size());
+        EXPECT_NEAR(mean, (sides + 1) / 2.0, 5 * sd + 1e-9) << sides;
+    }
+
+    std::vector<int64_t> histogram(3 * 5 + 1);
+    roller.addRollSums(histogram, 6, 3, 1 << 20);
+    for (auto [value, p] : DiceDistribution::getDiceDistribution({3, 6, 0}))
+    {
+        double expected = static_cast<double>(p) * (1 << 20);
+        EXPECT_NEAR(histogram[value - 3], expected, 5 * std::sqrt(expected) + 1) << value;
+    }
+    double sum = roller.rollSum(6, 1000000);
+    EXPECT_NEAR(sum / 1000000, 3.5, 0.01);
+}
+
+//exact probabilities, what the sampled CSVs converge to
+void outputDiceDistributionToCsv(std::string_view input)
+{
+    std::ofstream outputFile{std::string(input) + "_exact.csv"};
+    outputFile << "Value,Probability\n";
+    for (auto &[value, probability] : DiceDistribution::getDiceGroupDistribution(input))
+    {
+        outputFile << value << "," << static_cast<double>(probability) << "\n";
+    }
+}
+
 void outputDiceProbabilityToCsv(std::string_view input, int rollTimes = 1000)
 {
     std::map<int, int> diceRollsMap = DiceRandom::getDiceGroupRollCount(input, rollTimes);
@@ -59,6 +270,12 @@ int main()
     outputDiceProbabilityToCsv("1d10");
     outputDiceProbabilityToCsv("2d10");
     outputDiceProbabilityToCsv("3d10");
+    outputDiceDistributionToCsv("1d6");
+    outputDiceDistributionToCsv("2d6");
+    outputDiceDistributionToCsv("3d6");
+    outputDiceDistributionToCsv("1d10");
+    outputDiceDistributionToCsv("2d10");
+    outputDiceDistributionToCsv("3d10");
 
     testing::InitGoogleTest();
     return RUN_ALL_TESTS();
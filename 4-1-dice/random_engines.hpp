@@ -0,0 +1,237 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <limits>
+
+//small engines usable with the <random> distributions (UniformRandomBitGenerator) in place of std::mt19937:
+//a few words of state instead of 2.5KB and a handful of instructions per draw. all are seeded from one
+//64 bit value and can be moved far ahead, so independent streams can be cut out of one seed
+
+//Steele, Lea, Flood: a counter run through a 64 bit finalizer, so its position is just the counter
+class SplitMix64
+{
+public:
+    using result_type = uint64_t;
+
+    static constexpr uint64_t GAMMA = 0x9e3779b97f4a7c15;
+
+    explicit SplitMix64(uint64_t seed = 0) : m_state(seed) {}
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()()
+    {
+        uint64_t z = (m_state += GAMMA);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
+
+    void seed(uint64_t seed) { m_state = seed; }
+
+    //skips n outputs in O(1)
+    void discard(uint64_t n) { m_state += n * GAMMA; }
+
+    bool operator==(const SplitMix64& other) const = default;
+
+private:
+    uint64_t m_state;
+};
+
+//Blackman, Vigna: 256 bits of state, the general purpose default. discard is linear,
+//jump() moves 2^128 draws ahead for non overlapping streams
+class Xoshiro256StarStar
+{
+public:
+    using result_type = uint64_t;
+
+    explicit Xoshiro256StarStar(uint64_t seed = 0) { this->seed(seed); }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()()
+    {
+        uint64_t result = std::rotl(m_s[1] * 5, 7) * 9;
+        uint64_t t = m_s[1] << 17;
+        m_s[2] ^= m_s[0];
+        m_s[3] ^= m_s[1];
+        m_s[1] ^= m_s[2];
+        m_s[0] ^= m_s[3];
+        m_s[2] ^= t;
+        m_s[3] = std::rotl(m_s[3], 45);
+        return result;
+    }
+
+    //the state is filled from SplitMix64, as the authors recommend, so it's never all zero
+    void seed(uint64_t seed)
+    {
+        SplitMix64 init(seed);
+        for (auto& word : m_s) word = init();
+    }
+
+    void discard(uint64_t n)
+    {
+        for (; n > 0; n--) (*this)();
+    }
+
+    void jump()
+    {
+        constexpr uint64_t JUMP[] = {0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c};
+        std::array<uint64_t, 4> s{};
+        for (uint64_t word : JUMP)
+        {
+            for (int bit = 0; bit < 64; bit++)
+            {
+                if (word & (uint64_t(1) << bit))
+                    for (int i = 0; i < 4; i++) s[i] ^= m_s[i];
+                (*this)();
+            }
+        }
+        m_s = s;
+    }
+
+    bool operator==(const Xoshiro256StarStar& other) const = default;
+
+private:
+    std::array<uint64_t, 4> m_s;
+};
+
+//O'Neill: 128 bit LCG with the XSL RR output (pcg64 / pcg_setseq_128_xsl_rr_64).
+//stream selects one of 2^127 independent sequences, discard is O(log n)
+class Pcg64
+{
+public:
+    using result_type = uint64_t;
+
+    explicit Pcg64(uint64_t seed = 0, uint64_t stream = 0) { this->seed(seed, stream); }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    //the 128 bit variants output the advanced state
+    result_type operator()()
+    {
+        m_state = m_state * MULTIPLIER + m_increment;
+        uint64_t folded = static_cast<uint64_t>(m_state >> 64) ^ static_cast<uint64_t>(m_state);
+        return std::rotr(folded, static_cast<int>(m_state >> 122));
+    }
+
+    void seed(uint64_t seed, uint64_t stream = 0)
+    {
+        m_increment = (static_cast<unsigned __int128>(stream) << 1) | 1;
+        m_state = 0;
+        (*this)();
+        m_state += seed;
+        (*this)();
+    }
+
+    //Brown's jump ahead: the n step LCG is again an LCG, built by squaring
+    void discard(uint64_t n)
+    {
+        unsigned __int128 mult = MULTIPLIER;
+        unsigned __int128 inc = m_increment;
+        unsigned __int128 accMult = 1;
+        unsigned __int128 accInc = 0;
+        for (; n > 0; n >>= 1)
+        {
+            if (n & 1)
+            {
+                accMult *= mult;
+                accInc = accInc * mult + inc;
+            }
+            inc = (mult + 1) * inc;
+            mult *= mult;
+        }
+        m_state = accMult * m_state + accInc;
+    }
+
+    bool operator==(const Pcg64& other) const = default;
+
+private:
+    static constexpr unsigned __int128 MULTIPLIER =
+        (static_cast<unsigned __int128>(0x2360ed051fc65da4) << 64) | 0x4385df649fccf645;
+
+    unsigned __int128 m_state;
+    unsigned __int128 m_increment;
+};
+
+//Salmon et al. (Random123): the output is a 10 round bijection of a 128 bit counter under a 64 bit key,
+//so there is no state to advance. discard is O(1) and every key is an independent stream.
+//each counter gives 4 x 32 bits, returned as two 64 bit values
+class Philox4x32
+{
+public:
+    using result_type = uint64_t;
+    using Block = std::array<uint32_t, 4>;
+
+    explicit Philox4x32(uint64_t seed = 0) { this->seed(seed); }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()()
+    {
+        if (m_index == 0) m_block = generate(m_counter, m_key);
+        uint64_t result = (static_cast<uint64_t>(m_block[2 * m_index]) << 32) | m_block[2 * m_index + 1];
+        if (++m_index == 2)
+        {
+            m_index = 0;
+            if (++m_counter[0] == 0) m_counter[1]++;
+        }
+        return result;
+    }
+
+    void seed(uint64_t seed)
+    {
+        m_key = {static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)};
+        m_counter = {0, 0};
+        m_index = 0;
+    }
+
+    void discard(uint64_t n)
+    {
+        n += m_index;
+        m_index = static_cast<unsigned>(n & 1);
+        uint64_t before = m_counter[0];
+        m_counter[0] += n >> 1;
+        if (m_counter[0] < before) m_counter[1]++;
+        if (m_index != 0) m_block = generate(m_counter, m_key);
+    }
+
+    //the raw bijection, counter words low first
+    static Block generate(std::array<uint64_t, 2> counter, std::array<uint32_t, 2> key)
+    {
+        constexpr uint32_t M0 = 0xd2511f53;
+        constexpr uint32_t M1 = 0xcd9e8d57;
+        constexpr uint32_t W0 = 0x9e3779b9;
+        constexpr uint32_t W1 = 0xbb67ae85;
+        Block c = {static_cast<uint32_t>(counter[0]), static_cast<uint32_t>(counter[0] >> 32),
+                   static_cast<uint32_t>(counter[1]), static_cast<uint32_t>(counter[1] >> 32)};
+        for (int round = 0; round < 10; round++)
+        {
+            uint64_t p0 = static_cast<uint64_t>(M0) * c[0];
+            uint64_t p1 = static_cast<uint64_t>(M1) * c[2];
+            c = {static_cast<uint32_t>(p1 >> 32) ^ c[1] ^ key[0], static_cast<uint32_t>(p1),
+                 static_cast<uint32_t>(p0 >> 32) ^ c[3] ^ key[1], static_cast<uint32_t>(p0)};
+            key[0] += W0;
+            key[1] += W1;
+        }
+        return c;
+    }
+
+    //the cached block doesn't count, it's only valid while m_index != 0
+    bool operator==(const Philox4x32& other) const
+    {
+        return m_counter == other.m_counter && m_key == other.m_key && m_index == other.m_index;
+    }
+
+private:
+    std::array<uint64_t, 2> m_counter;
+    std::array<uint32_t, 2> m_key;
+    Block m_block{};
+    unsigned m_index;
+};